@@ -32,6 +32,7 @@
 #define OUT
 
 typedef unsigned int		uint32;
+typedef unsigned long long	uint64;
 typedef unsigned short int	ushort;
 typedef unsigned char		uchar;
 typedef unsigned char		utf8;
\ No newline at end of file
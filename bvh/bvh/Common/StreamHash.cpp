@@ -0,0 +1,135 @@
+#include "StreamHash.h"
+#include <string.h>
+
+static const uint64 kPrime1 = 11400714785074694791ULL;
+static const uint64 kPrime2 = 14029467366897019727ULL;
+static const uint64 kPrime3 = 1609587929392839161ULL;
+static const uint64 kPrime4 = 9650029242287828579ULL;
+static const uint64 kPrime5 = 2870177450012600261ULL;
+
+static inline uint64 RotateLeft(uint64 value, int count)
+{
+	return (value << count) | (value >> (64 - count));
+}
+
+static inline uint64 Read64(const unsigned char* p)
+{
+	uint64 value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint32 Read32(const unsigned char* p)
+{
+	uint32 value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint64 Round(uint64 accumulator, uint64 input)
+{
+	accumulator += input * kPrime2;
+	accumulator = RotateLeft(accumulator, 31);
+	return accumulator * kPrime1;
+}
+
+static inline uint64 MergeRound(uint64 accumulator, uint64 value)
+{
+	accumulator ^= Round(0, value);
+	return accumulator * kPrime1 + kPrime4;
+}
+
+StreamHash::StreamHash(uint64 seed)
+	: _seed(seed)
+	, _totalSize(0)
+	, _bufferSize(0)
+{
+	_lane[0] = seed + kPrime1 + kPrime2;
+	_lane[1] = seed + kPrime2;
+	_lane[2] = seed;
+	_lane[3] = seed - kPrime1;
+}
+
+void StreamHash::Update(const void* data, size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	const unsigned char* const end = p + size;
+
+	_totalSize += size;
+
+	if (_bufferSize + size < sizeof(_buffer))
+	{
+		memcpy(_buffer + _bufferSize, p, size);
+		_bufferSize += size;
+		return;
+	}
+
+	if (0 < _bufferSize)
+	{
+		const size_t fillSize = sizeof(_buffer) - _bufferSize;
+		memcpy(_buffer + _bufferSize, p, fillSize);
+		p += fillSize;
+
+		for (int i = 0; i < 4; ++i)
+			_lane[i] = Round(_lane[i], Read64(_buffer + i * 8));
+		_bufferSize = 0;
+	}
+
+	for (; p + 32 <= end; p += 32)
+	{
+		_lane[0] = Round(_lane[0], Read64(p + 0));
+		_lane[1] = Round(_lane[1], Read64(p + 8));
+		_lane[2] = Round(_lane[2], Read64(p + 16));
+		_lane[3] = Round(_lane[3], Read64(p + 24));
+	}
+
+	_bufferSize = static_cast<size_t>(end - p);
+	memcpy(_buffer, p, _bufferSize);
+}
+
+uint64 StreamHash::GetResult() const
+{
+	uint64 result;
+	if (32 <= _totalSize)
+	{
+		result = RotateLeft(_lane[0], 1) + RotateLeft(_lane[1], 7) + RotateLeft(_lane[2], 12) + RotateLeft(_lane[3], 18);
+		for (int i = 0; i < 4; ++i)
+			result = MergeRound(result, _lane[i]);
+	}
+	else
+	{
+		result = _seed + kPrime5;
+	}
+
+	result += _totalSize;
+
+	const unsigned char* p = _buffer;
+	const unsigned char* const end = _buffer + _bufferSize;
+
+	for (; p + 8 <= end; p += 8)
+	{
+		result ^= Round(0, Read64(p));
+		result = RotateLeft(result, 27) * kPrime1 + kPrime4;
+	}
+
+	if (p + 4 <= end)
+	{
+		result ^= static_cast<uint64>(Read32(p)) * kPrime1;
+		result = RotateLeft(result, 23) * kPrime2 + kPrime3;
+		p += 4;
+	}
+
+	for (; p < end; ++p)
+	{
+		result ^= (*p) * kPrime5;
+		result = RotateLeft(result, 11) * kPrime1;
+	}
+
+	result ^= result >> 33;
+	result *= kPrime2;
+	result ^= result >> 29;
+	result *= kPrime3;
+	result ^= result >> 32;
+
+	return result;
+}
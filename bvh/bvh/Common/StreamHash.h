@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Common.h"
+#include <stddef.h>
+
+// xxHash64 (https://github.com/Cyan4973/xxHash) fed incrementally.
+// Update can be called any number of times, the result only depends on the concatenated bytes.
+class StreamHash final
+{
+public:
+	explicit StreamHash(uint64 seed = 0);
+
+	void Update(const void* data, size_t size);
+	template <typename T> void UpdateValue(const T& value) { Update(&value, sizeof(T)); }
+
+	uint64 GetResult() const;
+
+private:
+	uint64 _seed;
+	uint64 _lane[4];
+	uint64 _totalSize;
+
+	unsigned char _buffer[32];
+	size_t _bufferSize;
+};
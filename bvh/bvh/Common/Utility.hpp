@@ -6,6 +6,8 @@
 #include <assert.h>
 #include <Windows.h>
 
+#include "StreamHash.h"
+
 namespace Utility
 {
 	class String
@@ -70,13 +72,17 @@ namespace Utility
 			return ParseNameAndFormat( &path.c_str()[fileNameStartPos+1] );
 		}
 
+		// Hashes the keys in place, no concatenated temporary. lengths are mixed in so {"ab", "c"} and {"a", "bc"} differ.
 		static uint32 MakeKey(const std::vector<std::string>& keys)
 		{
-			std::string result = "";
+			StreamHash hash;
 			for (auto& iter : keys)
-				result += iter;
+			{
+				hash.Update(iter.data(), iter.size());
+				hash.UpdateValue(static_cast<uint64>(iter.size()));
+			}
 
-			return std::hash<std::string>()(result);
+			return static_cast<uint32>(hash.GetResult());
 		}
 
 	};
@@ -1,8 +1,18 @@
 #include "KdTree.h"
+#include "KdTreeCache.h"
+#include "Half.h"
 #include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <unordered_map>
 
 const float kMaxBoxLength = 1000000.0f;
 
+// Note(jinpark) : a half bound is off by up to 2^-11 of its block extent, this keeps that within 2^-8 of the node extent.
+const float kHalfKdBlockExtentRatio = 8.0f;
+const ushort kHalfPositiveInfinity = 0x7c00;
+const ushort kHalfNegativeInfinity = 0xfc00;
+
 static float3 getVertex(const void* vertices, uint32 vertexIndex, uint32 stride)
 {
 	const float3* position = reinterpret_cast<const float3*>(reinterpret_cast<const char*>(vertices) + (vertexIndex * stride));
@@ -23,235 +33,1701 @@ static void float3Max(float3& source, const float3& rhs)
 	source.z = std::max(source.z, rhs.z);
 }
 
-void KdTree::buildBoundBox(float3& out_bbMin, float3& out_bbMax, const std::vector<RawKdNodeData>& nodeArray, uint32 beginIndex, uint32 endIndex)
+static float computeSurfaceArea(const float3& bbMin, const float3& bbMax)
 {
-	if (beginIndex == endIndex)
+	const float3 extents = (bbMax - bbMin);
+	return (extents.x * extents.y + extents.y * extents.z + extents.x * extents.z) * 2.0f;
+}
+
+static float getMaxExtent(const float3& bbMin, const float3& bbMax)
+{
+	const float3 extents = (bbMax - bbMin);
+	return std::max(extents.x, std::max(extents.y, extents.z));
+}
+
+static float decodeHalfBound(const ushort bits, const float origin, const float scale)
+{
+	return origin + static_cast<float>(Half(bits)) * scale;
+}
+
+static ushort getNextHalfUp(const ushort bits)
+{
+	if (0 != (bits & 0x8000))
 	{
-		out_bbMin = float3(0.0f, 0.0f, 0.0f);
-		out_bbMax = float3(0.0f, 0.0f, 0.0f);
+		return (0x8000 == bits) ? 0x0001 : (bits - 1);
+	}
+	return bits + 1;
+}
+
+static ushort getNextHalfDown(const ushort bits)
+{
+	if (0 != (bits & 0x8000))
+	{
+		return bits + 1;
+	}
+	return (0x0000 == bits) ? 0x8001 : (bits - 1);
+}
+
+static uint32 floatAsUint32(const float value)
+{
+	uint32 result;
+	memcpy(&result, &value, sizeof(result));
+	return result;
+}
+
+static void buildWoopLeaf(PackedKdNode* outLeafNodes, const float3& position0, const float3& position1, const float3& position2, const uint32 primitiveIndex)
+{
+	// Note(jinpark) : inverse of [edge0 edge1 normal] in double, the rows are (edge1 x n, n x edge0, n) / |n|^2.
+	const double p0[3] = { position0.x, position0.y, position0.z };
+	const double edge0[3] = { position1.x - p0[0], position1.y - p0[1], position1.z - p0[2] };
+	const double edge1[3] = { position2.x - p0[0], position2.y - p0[1], position2.z - p0[2] };
+
+	auto cross = [](double out[3], const double lhs[3], const double rhs[3])
+	{
+		out[0] = lhs[1] * rhs[2] - lhs[2] * rhs[1];
+		out[1] = lhs[2] * rhs[0] - lhs[0] * rhs[2];
+		out[2] = lhs[0] * rhs[1] - lhs[1] * rhs[0];
+	};
+	auto dot = [](const double lhs[3], const double rhs[3]) { return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2]; };
+
+	double normal[3], row0[3], row1[3];
+	cross(normal, edge0, edge1);
+	cross(row0, edge1, normal);
+	cross(row1, normal, edge0);
+
+	const double normalLengthSquared = dot(normal, normal);
+	if (0.0 == normalLengthSquared)
+	{
+		// Note(jinpark) : degenerate triangle, u is always -1 so it never hits.
+		outLeafNodes[0]._parameter0 = float3(0.0f, 0.0f, 0.0f);
+		outLeafNodes[0]._parameter1 = primitiveIndex;
+		outLeafNodes[1]._parameter0 = float3(0.0f, 0.0f, 0.0f);
+		outLeafNodes[1]._parameter1 = floatAsUint32(-1.0f);
+		outLeafNodes[2]._parameter0 = float3(0.0f, 0.0f, 0.0f);
+		outLeafNodes[2]._parameter1 = floatAsUint32(0.0f);
 		return;
 	}
 
-	out_bbMin = float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength);
-	out_bbMax = -out_bbMin;
+	uint32 k = 0;
+	if (fabs(normal[1]) > fabs(normal[k])) k = 1;
+	if (fabs(normal[2]) > fabs(normal[k])) k = 2;
+	const uint32 a = (k + 1) % 3;
+	const uint32 b = (k + 2) % 3;
 
-	for (uint32 i = beginIndex; i < endIndex; ++i)
+	// Note(jinpark) : t only depends on the ratio of row 2 terms, scaling it by 1 / normal[k] keeps t and drops one value.
+	const double row2[3] = { normal[0] / normal[k], normal[1] / normal[k], normal[2] / normal[k] };
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
 	{
-		float3Min(out_bbMin, nodeArray[i]._bbMin);
-		float3Max(out_bbMax, nodeArray[i]._bbMax);
+		row0[axisIndex] /= normalLengthSquared;
+		row1[axisIndex] /= normalLengthSquared;
 	}
+
+	outLeafNodes[0]._parameter0 = float3(static_cast<float>(row0[0]), static_cast<float>(row0[1]), static_cast<float>(row0[2]));
+	outLeafNodes[0]._parameter1 = (k << 30) | primitiveIndex;
+	outLeafNodes[1]._parameter0 = float3(static_cast<float>(row1[0]), static_cast<float>(row1[1]), static_cast<float>(row1[2]));
+	outLeafNodes[1]._parameter1 = floatAsUint32(static_cast<float>(-dot(row0, p0)));
+	outLeafNodes[2]._parameter0 = float3(static_cast<float>(row2[a]), static_cast<float>(row2[b]), static_cast<float>(-dot(row2, p0)));
+	outLeafNodes[2]._parameter1 = floatAsUint32(static_cast<float>(-dot(row1, p0)));
 }
 
-uint32 KdTree::buildInternal(std::vector<RawKdNodeData>& nodeArray, const uint32 beginIndex, const uint32 endIndex)
+// Note(jinpark) : the decoded bound must never be inside the real one, so step by one half ulp until it is outside.
+static ushort encodeHalfBound(const float value, const float origin, const float scale, const bool isRoundUp)
 {
-	const uint32 count = endIndex - beginIndex;
-	if (1 == count)
+	ushort bits = Half((value - origin) / scale).GetValue();
+	if (true == isRoundUp)
+	{
+		while (decodeHalfBound(bits, origin, scale) < value)
+		{
+			bits = getNextHalfUp(bits);
+		}
+	}
+	else
 	{
-		return beginIndex;
+		while (value < decodeHalfBound(bits, origin, scale))
+		{
+			bits = getNextHalfDown(bits);
+		}
 	}
+	return bits;
+}
 
-	float3 bbMin, bbMax;
-	buildBoundBox(bbMin, bbMax, nodeArray, beginIndex, endIndex);
+static uint64 makeEdgeKey(const uint32 vertexIndex0, const uint32 vertexIndex1)
+{
+	return (static_cast<uint64>(std::min(vertexIndex0, vertexIndex1)) << 32) | std::max(vertexIndex0, vertexIndex1);
+}
 
-	uint32 midIndex = (endIndex - 1);
-	{
-		float3 extensts = bbMax - bbMin;
+// Note(jinpark) : greedy, a triangle pairs with the first unpaired triangle seen on one of its edges.
+//				   the generators emit the two triangles of a quad back to back, so those always pair up.
+static void pairTriangles(std::vector<uint32>& outPairArray, const uint32* indices, const uint32 primitiveCount)
+{
+	outPairArray.assign(primitiveCount, 0xffffffff);
 
-		uint32 dominantAxisIndex = 0xffffffff;
+	std::unordered_map<uint64, uint32> openEdgeMap;
+	openEdgeMap.reserve(primitiveCount * 3);
 
-		if (extensts.x >= extensts.y && extensts.x >= extensts.z)		dominantAxisIndex = 0;
-		else if (extensts.y >= extensts.x && extensts.y >= extensts.z)	dominantAxisIndex = 1;
-		else if (extensts.z >= extensts.x && extensts.z >= extensts.y)	dominantAxisIndex = 2;
-		assert(0xffffffff != dominantAxisIndex);
+	for (uint32 primitiveIndex = 0; primitiveIndex < primitiveCount; ++primitiveIndex)
+	{
+		const uint32* triangle = indices + primitiveIndex * 3;
+
+		for (uint32 edgeIndex = 0; edgeIndex < 3; ++edgeIndex)
+		{
+			const uint32 vertexIndex0 = triangle[edgeIndex];
+			const uint32 vertexIndex1 = triangle[(edgeIndex + 1) % 3];
+			if (vertexIndex0 == vertexIndex1)
+			{
+				continue;
+			}
 
-		std::sort(nodeArray.begin() + beginIndex, nodeArray.begin() + endIndex,
-			[axisIndex = dominantAxisIndex](const RawKdNodeData& lhs, const RawKdNodeData& rhs)
+			auto found = openEdgeMap.find(makeEdgeKey(vertexIndex0, vertexIndex1));
+			if ((openEdgeMap.end() != found) && (0xffffffff == outPairArray[found->second]))
 			{
-				return lhs._center[axisIndex] < rhs._center[axisIndex];
-			});
+				outPairArray[found->second] = primitiveIndex;
+				outPairArray[primitiveIndex] = found->second;
+				break;
+			}
+		}
+
+		if (0xffffffff != outPairArray[primitiveIndex])
+		{
+			continue;
+		}
+
+		for (uint32 edgeIndex = 0; edgeIndex < 3; ++edgeIndex)
+		{
+			openEdgeMap.emplace(makeEdgeKey(triangle[edgeIndex], triangle[(edgeIndex + 1) % 3]), primitiveIndex);
+		}
+	}
+}
+
+static bool isSharedEdge(const uint32* triangle, const uint32 vertexIndex0, const uint32 vertexIndex1)
+{
+	if (vertexIndex0 == vertexIndex1)
+	{
+		return false;
+	}
+
+	const bool hasVertex0 = (triangle[0] == vertexIndex0) || (triangle[1] == vertexIndex0) || (triangle[2] == vertexIndex0);
+	const bool hasVertex1 = (triangle[0] == vertexIndex1) || (triangle[1] == vertexIndex1) || (triangle[2] == vertexIndex1);
+	return hasVertex0 && hasVertex1;
+}
+
+// Note(jinpark) : triangle 0 is rotated so its shared edge becomes (v2, v0), triangle 1 fills its corners from (v0, v2, v3).
+static void buildQuadLeaf(PackedKdNode* outLeafNodes, const KdTreeMeshView& meshView, const uint32 primitiveIndex0, const uint32 primitiveIndex1)
+{
+	const bool isPaired = (0xffffffff != primitiveIndex1);
+
+	uint32 triangle0[3], triangle1[3];
+	for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+	{
+		triangle0[cornerIndex] = meshView.getVertexIndex(primitiveIndex0 * 3 + cornerIndex);
+		triangle1[cornerIndex] = (true == isPaired) ? meshView.getVertexIndex(primitiveIndex1 * 3 + cornerIndex) : 0xffffffff;
+	}
 
-		const float splitPos = (bbMin[dominantAxisIndex] + bbMax[dominantAxisIndex]) * 0.5f;
-		for (uint32 i = beginIndex + 1; i < endIndex; ++i)
+	uint32 rotation = 0;
+	if (true == isPaired)
+	{
+		for (uint32 edgeIndex = 0; edgeIndex < 3; ++edgeIndex)
 		{
-			if (splitPos <= nodeArray[i]._center[dominantAxisIndex])
+			if (true == isSharedEdge(triangle1, triangle0[edgeIndex], triangle0[(edgeIndex + 1) % 3]))
 			{
-				midIndex = i;
+				rotation = (edgeIndex + 1) % 3;
 				break;
 			}
 		}
 	}
-	
-	RawKdNodeData newNode;
-	newNode._leftNodeIndex = buildInternal(nodeArray, beginIndex, midIndex);
-	newNode._rightNodeIndex = buildInternal(nodeArray, midIndex, endIndex);
 
-	auto computeSurfaceArea = [](const RawKdNodeData& nodeData)
+	uint32 quadIndices[4];
+	uint32 cornerLanes0[3];
+	for (uint32 laneIndex = 0; laneIndex < 3; ++laneIndex)
 	{
-		const float3 extents = (nodeData._bbMax - nodeData._bbMin);
-		return (extents.x * extents.y + extents.y * extents.z + extents.x * extents.z) * 2.0f;
-	};
+		quadIndices[laneIndex] = triangle0[(laneIndex + rotation) % 3];
+		cornerLanes0[(laneIndex + rotation) % 3] = laneIndex;
+	}
+	quadIndices[3] = quadIndices[2];
+
+	uint32 cornerLanes1[3] = { 0, 1, 2 };
+	if (true == isPaired)
+	{
+		const uint32 unassigned = 0xffffffff;
+		cornerLanes1[0] = cornerLanes1[1] = cornerLanes1[2] = unassigned;
+
+		for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			if (triangle1[cornerIndex] == quadIndices[0])
+			{
+				cornerLanes1[cornerIndex] = 0;
+				break;
+			}
+		}
+		for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			if ((unassigned == cornerLanes1[cornerIndex]) && (triangle1[cornerIndex] == quadIndices[2]))
+			{
+				cornerLanes1[cornerIndex] = 1;
+				break;
+			}
+		}
+		for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			if (unassigned == cornerLanes1[cornerIndex])
+			{
+				cornerLanes1[cornerIndex] = 2;
+				quadIndices[3] = triangle1[cornerIndex];
+				break;
+			}
+		}
+	}
 
-	const float leftNodeSurfaceArea = computeSurfaceArea(nodeArray[newNode._leftNodeIndex]);
-	const float rightNodeSurfaceArea = computeSurfaceArea(nodeArray[newNode._rightNodeIndex]);
+	float3 positions[4];
+	for (uint32 cornerIndex = 0; cornerIndex < 4; ++cornerIndex)
+	{
+		positions[cornerIndex] = meshView.getPosition(quadIndices[cornerIndex]);
+	}
 
-	// Note(jinpark) : left  ҰŶ left node arae  ū  .
-	if (leftNodeSurfaceArea < rightNodeSurfaceArea)
+	const float3 edges[] = { positions[1] - positions[0], positions[2] - positions[0], positions[3] - positions[0] };
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
 	{
-		std::swap(newNode._leftNodeIndex, newNode._rightNodeIndex);
+		outLeafNodes[axisIndex]._parameter0 = float3(edges[0][axisIndex], edges[1][axisIndex], edges[2][axisIndex]);
 	}
 
-	newNode._bbMin = bbMin;
-	newNode._bbMax = bbMax;
-	newNode._center = (bbMin + bbMax) * 0.5f;
-	newNode._primitiveIndex = 0xffffffff;
-	
-	const uint32 newNodeIndex = static_cast<uint32>(nodeArray.size());
-	nodeArray[newNode._leftNodeIndex]._parentNodeIndex = newNodeIndex;
-	nodeArray[newNode._rightNodeIndex]._parentNodeIndex = newNodeIndex;
-	nodeArray.push_back(newNode);
+	outLeafNodes[0]._parameter1 = primitiveIndex0;
+	outLeafNodes[1]._parameter1 = primitiveIndex1;
+	outLeafNodes[2]._parameter1 = (cornerLanes0[1] | (cornerLanes0[2] << 2)) | ((cornerLanes1[1] | (cornerLanes1[2] << 2)) << 4);
+	outLeafNodes[3]._parameter0 = positions[0];
+	outLeafNodes[3]._parameter1 = 0;
+}
+
+uint32 KdTreeMeshView::getVertexIndex(const uint32 cornerIndex) const
+{
+	switch (_indexFormat)
+	{
+	case KdTreeIndexFormat::UInt16:
+		return static_cast<const ushort*>(_indices)[cornerIndex];
+
+	case KdTreeIndexFormat::None:
+		return cornerIndex;
 
-	return newNodeIndex;
+	default:
+		return static_cast<const uint32*>(_indices)[cornerIndex];
+	}
 }
 
-static void buildNodeOrderInternal(std::vector<RawKdNodeData>& nodeArray, uint32 nodeIndex, uint32 nodeNextIndex, uint32& order)
+float3 KdTreeMeshView::getPosition(const uint32 vertexIndex) const
 {
-	RawKdNodeData& node = nodeArray[nodeIndex];
-	
-	node._orderIndex	= order++;
-	node._nextNodeIndex = nodeNextIndex;
+	const char* vertex = static_cast<const char*>(_vertices) + static_cast<size_t>(vertexIndex) * _stride;
+
+	switch (_vertexFormat)
+	{
+	case KdTreeVertexFormat::Half3:
+	{
+		ushort bits[3];
+		memcpy(bits, vertex, sizeof(bits));
+		return float3(Half(bits[0]), Half(bits[1]), Half(bits[2]));
+	}
 
-	if (0xffffffff != node._leftNodeIndex)
+	case KdTreeVertexFormat::Snorm16x3:
 	{
-		buildNodeOrderInternal(nodeArray, node._leftNodeIndex, node._rightNodeIndex, order);
+		short values[3];
+		memcpy(values, vertex, sizeof(values));
+
+		float3 position;
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			position[axisIndex] = std::max(static_cast<float>(values[axisIndex]) / 32767.0f, -1.0f) * _positionScale[axisIndex] + _positionOffset[axisIndex];
+		}
+		return position;
 	}
-	
-	if (0xffffffff != node._rightNodeIndex)
+
+	case KdTreeVertexFormat::Unorm16x3:
 	{
-		buildNodeOrderInternal(nodeArray, node._rightNodeIndex, node._nextNodeIndex, order);
+		ushort values[3];
+		memcpy(values, vertex, sizeof(values));
+
+		float3 position;
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			position[axisIndex] = (static_cast<float>(values[axisIndex]) / 65535.0f) * _positionScale[axisIndex] + _positionOffset[axisIndex];
+		}
+		return position;
+	}
+
+	default:
+		return *reinterpret_cast<const float3*>(vertex);
 	}
 }
 
-void KdTree::buildNodeOrder(std::vector<RawKdNodeData>& nodeArray, const uint32 rootNodeIndex)
+uint32 KdTreeMeshView::getIndexByteCount() const
 {
-	uint32 order = 0;
-	buildNodeOrderInternal(nodeArray, rootNodeIndex, 0xffffffff, order);
+	switch (_indexFormat)
+	{
+	case KdTreeIndexFormat::UInt16:
+		return sizeof(ushort);
+
+	case KdTreeIndexFormat::None:
+		return 0;
+
+	default:
+		return sizeof(uint32);
+	}
 }
 
-void KdTree::build(std::vector<PackedKdNode>& outPackedNodeArray, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+uint32 KdTreeMeshView::getVertexByteCount() const
 {
-	assert(0 == (indexCount % 3));
-	const uint32 primitiveCount = indexCount / 3;
-	
-	std::vector<RawKdNodeData> rawNodeDataArray;
+	return (KdTreeVertexFormat::Float3 == _vertexFormat) ? sizeof(float3) : (sizeof(ushort) * 3);
+}
 
-	// Note(jinpark) : 1 step - build primitive node
-	for (uint32 primitiveIndex = 0; primitiveIndex < primitiveCount; ++primitiveIndex)
+void KdTree::buildBoundBox(float3& out_bbMin, float3& out_bbMax, const KdPrimitiveArray& primitiveArray, uint32 beginIndex, uint32 endIndex)
+{
+	if (beginIndex == endIndex)
 	{
-		float3 boxMin = float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength);
-		float3 boxMax = -boxMin;
+		out_bbMin = float3(0.0f, 0.0f, 0.0f);
+		out_bbMax = float3(0.0f, 0.0f, 0.0f);
+		return;
+	}
 
-		float3 positions[] = {	getVertex(vertices, indices[primitiveIndex * 3 + 0], stride),
-								getVertex(vertices, indices[primitiveIndex * 3 + 1], stride) ,
-								getVertex(vertices, indices[primitiveIndex * 3 + 2], stride) };
+	out_bbMin = float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength);
+	out_bbMax = -out_bbMin;
 
-		for (uint32 i = 0; i < 3; ++i)
+	for (uint32 i = beginIndex; i < endIndex; ++i)
+	{
+		const uint32 primitiveIndex = primitiveArray._primitiveIndexArray[i];
+		float3Min(out_bbMin, primitiveArray._bbMinArray[primitiveIndex]);
+		float3Max(out_bbMax, primitiveArray._bbMaxArray[primitiveIndex]);
+	}
+}
+
+uint32 KdTree::splitPrimitiveArray(KdPrimitiveArray& primitiveArray, const uint32 beginIndex, const uint32 endIndex, const float3& bbMin, const float3& bbMax)
+{
+	uint32 midIndex = (endIndex - 1);
+
+	float3 extensts = bbMax - bbMin;
+
+	uint32 dominantAxisIndex = 0xffffffff;
+
+	if (extensts.x >= extensts.y && extensts.x >= extensts.z)		dominantAxisIndex = 0;
+	else if (extensts.y >= extensts.x && extensts.y >= extensts.z)	dominantAxisIndex = 1;
+	else if (extensts.z >= extensts.x && extensts.z >= extensts.y)	dominantAxisIndex = 2;
+	assert(0xffffffff != dominantAxisIndex);
+
+	// Note(jinpark) : center is not stored, (bbMin + bbMax) is compared with (splitPos * 2) instead.
+	//				   keys are gathered once so the sort runs on contiguous memory.
+	std::vector<uint32>& primitiveIndexArray = primitiveArray._primitiveIndexArray;
+	std::vector<KdSortKey>& sortKeyArray = primitiveArray._sortKeyArray;
+	sortKeyArray.resize(primitiveArray.getCount());
+
+	for (uint32 i = beginIndex; i < endIndex; ++i)
+	{
+		const uint32 primitiveIndex = primitiveIndexArray[i];
+		sortKeyArray[i]._center2 = primitiveArray._bbMinArray[primitiveIndex][dominantAxisIndex] + primitiveArray._bbMaxArray[primitiveIndex][dominantAxisIndex];
+		sortKeyArray[i]._primitiveIndex = primitiveIndex;
+	}
+
+	std::sort(sortKeyArray.begin() + beginIndex, sortKeyArray.begin() + endIndex,
+		[](const KdSortKey& lhs, const KdSortKey& rhs)
 		{
-			float3Min(boxMin, positions[i]);
-			float3Max(boxMax, positions[i]);
+			return lhs._center2 < rhs._center2;
+		});
+
+	const float splitPos2 = (bbMin[dominantAxisIndex] + bbMax[dominantAxisIndex]);
+	bool isSplitFound = false;
+	for (uint32 i = beginIndex + 1; i < endIndex; ++i)
+	{
+		if (splitPos2 <= sortKeyArray[i]._center2)
+		{
+			// Note(jinpark) : valid only if some center is strictly left of the split position.
+			isSplitFound = (sortKeyArray[i - 1]._center2 < splitPos2);
+			midIndex = i;
+			break;
 		}
+	}
+
+	// Note(jinpark) : coincident centers (duplicated triangles) peel off one primitive per level,
+	//				   which is O(n^2) and n levels deep. object median keeps it O(n log n).
+	if (false == isSplitFound)
+	{
+		midIndex = beginIndex + (endIndex - beginIndex) / 2;
+	}
 
-		RawKdNodeData primitiveNode;
-		primitiveNode._bbMin = boxMin;
-		primitiveNode._bbMax = boxMax;
-		primitiveNode._primitiveIndex = primitiveIndex;
-		primitiveNode._center = (boxMin + boxMax) * 0.5f;
-		primitiveNode._primitiveArea = float3::Cross(positions[2] - positions[0], positions[1] - positions[0]).Length() * 0.5f;
-		rawNodeDataArray.push_back(primitiveNode);
+	for (uint32 i = beginIndex; i < endIndex; ++i)
+	{
+		primitiveIndexArray[i] = sortKeyArray[i]._primitiveIndex;
 	}
 
-	const uint32 primitiveNodeCount = static_cast<uint32>(rawNodeDataArray.size());
-	const uint32 rootNodeIndex = buildInternal(rawNodeDataArray, 0, primitiveNodeCount);
+	return midIndex;
+}
+
+void KdTree::buildInternal(PackedKdNode* outPackedNodes, KdPrimitiveArray& primitiveArray, const KdTreeMeshView& meshView, const float3& bbMin, const float3& bbMax)
+{
+	// Note(jinpark) : packed data ũⰡ 16byte, primitive position 0   2.
+	const uint32 kdNodeCount = primitiveArray.getCount() * 2 - 1;
+
+	// Note(jinpark) : explicit stack instead of recursion, deep trees must not overflow the thread stack.
+	std::vector<KdBuildTask>& taskArray = primitiveArray._buildTaskArray;
+	taskArray.clear();
 
-	// Note(jinpark) : 2 step - build order index
-	buildNodeOrder(rawNodeDataArray, rootNodeIndex);
+	KdBuildTask rootTask;
+	rootTask._beginIndex = 0;
+	rootTask._endIndex = primitiveArray.getCount();
+	rootTask._bbMin = bbMin;
+	rootTask._bbMax = bbMax;
+	rootTask._nodeIndex = 0;
+	rootTask._nextNodeIndex = 0xffffffff;
+	taskArray.push_back(rootTask);
 
-	// Note(jinpark) : 3 step - raw  , kdNode ȯ
-	std::vector<KdNode> kdNodeArray;
+	while (false == taskArray.empty())
 	{
-		kdNodeArray.resize(rawNodeDataArray.size());
+		const KdBuildTask task = taskArray.back();
+		taskArray.pop_back();
 
-		const uint32 rawNodeCount = rawNodeDataArray.size();
-		for (uint32 rawNodeIndex = 0; rawNodeIndex < rawNodeCount; ++rawNodeIndex)
+		const uint32 beginIndex = task._beginIndex;
+		const uint32 endIndex = task._endIndex;
+		const uint32 nodeIndex = task._nodeIndex;
+
+		const uint32 count = endIndex - beginIndex;
+		if (1 == count)
 		{
-			const RawKdNodeData& rawNode = rawNodeDataArray[rawNodeIndex];
+			const uint32 primitiveIndex = primitiveArray._primitiveIndexArray[beginIndex];
 
-			KdNode& newNode = kdNodeArray[rawNode._orderIndex];
+			float3 positions[] = {	meshView.getCornerPosition(primitiveIndex, 0),
+									meshView.getCornerPosition(primitiveIndex, 1),
+									meshView.getCornerPosition(primitiveIndex, 2) };
 
-			newNode._bbMin = rawNode._bbMin;
-			newNode._bbMax = rawNode._bbMax;
-			newNode._primitiveIndex = rawNode._primitiveIndex;
+			// Note(jinpark) : leaf node primitive primitiveǷ edge ͸  
+			PackedKdNode& primitiveNode0 = outPackedNodes[nodeIndex * 2 + 0];
+			primitiveNode0._parameter0 = positions[1] - positions[0];	// Note(jinpark) : edge ƴ϶ position1 Ѱܵ ʳ?
+			primitiveNode0._parameter1 = primitiveIndex + kdNodeCount * 2;
 
-			newNode._nextNodeIndex = 0xffffffff;
-			if (0xffffffff != rawNode._nextNodeIndex)
-			{
-				newNode._nextNodeIndex = rawNodeDataArray[rawNode._nextNodeIndex]._orderIndex;
-			}
+			PackedKdNode& primitiveNode1 = outPackedNodes[nodeIndex * 2 + 1];
+			primitiveNode1._parameter0 = positions[2] - positions[0];
+			primitiveNode1._parameter1 = task._nextNodeIndex;
+			continue;
 		}
+
+		PackedKdNode& packedNode0 = outPackedNodes[nodeIndex * 2 + 0];
+		packedNode0._parameter0 = task._bbMin;
+		packedNode0._parameter1 = 0xffffffff;
+
+		PackedKdNode& packedNode1 = outPackedNodes[nodeIndex * 2 + 1];
+		packedNode1._parameter0 = task._bbMax;
+		packedNode1._parameter1 = task._nextNodeIndex;
+
+		const uint32 midIndex = splitPrimitiveArray(primitiveArray, beginIndex, endIndex, task._bbMin, task._bbMax);
+
+		KdBuildTask leftTask;
+		leftTask._beginIndex = beginIndex;
+		leftTask._endIndex = midIndex;
+		buildBoundBox(leftTask._bbMin, leftTask._bbMax, primitiveArray, beginIndex, midIndex);
+
+		KdBuildTask rightTask;
+		rightTask._beginIndex = midIndex;
+		rightTask._endIndex = endIndex;
+		buildBoundBox(rightTask._bbMin, rightTask._bbMax, primitiveArray, midIndex, endIndex);
+
+		// Note(jinpark) : left  ҰŶ left node arae  ū  .
+		const bool isRightFirst = computeSurfaceArea(leftTask._bbMin, leftTask._bbMax) < computeSurfaceArea(rightTask._bbMin, rightTask._bbMax);
+		KdBuildTask& firstTask = (true == isRightFirst) ? rightTask : leftTask;
+		KdBuildTask& secondTask = (true == isRightFirst) ? leftTask : rightTask;
+
+		// Note(jinpark) : pre-order layout, a subtree of n primitives has (n * 2 - 1) nodes.
+		const uint32 secondNodeIndex = nodeIndex + 1 + (firstTask._endIndex - firstTask._beginIndex) * 2 - 1;
+		firstTask._nodeIndex = nodeIndex + 1;
+		firstTask._nextNodeIndex = secondNodeIndex;
+		secondTask._nodeIndex = secondNodeIndex;
+		secondTask._nextNodeIndex = task._nextNodeIndex;
+
+		taskArray.push_back(secondTask);
+		taskArray.push_back(firstTask);
 	}
+}
+
+void KdTree::buildIndexedInternal(IndexedKdTree& outIndexedTree, KdPrimitiveArray& primitiveArray, const KdTreeMeshView& meshView, const float3& bbMin, const float3& bbMax)
+{
+	// Note(jinpark) : vertices are compacted in leaf order, so neighbouring leaves share cache lines.
+	std::vector<uint32> vertexRemapArray;
+
+	std::vector<KdBuildTask>& taskArray = primitiveArray._buildTaskArray;
+	taskArray.clear();
 
-	std::vector<PackedKdNode> packedNodeArray;
+	KdBuildTask rootTask;
+	rootTask._beginIndex = 0;
+	rootTask._endIndex = primitiveArray.getCount();
+	rootTask._bbMin = bbMin;
+	rootTask._bbMax = bbMax;
+	rootTask._nodeIndex = 0;
+	rootTask._nextNodeIndex = getIndexedNodeCount(primitiveArray.getCount());
+	taskArray.push_back(rootTask);
 
-	const uint32 kdNodeCount = kdNodeArray.size();
-	for (uint32 kdNodeIndex = 0; kdNodeIndex < kdNodeCount; ++kdNodeIndex)
+	while (false == taskArray.empty())
 	{
-		const KdNode& kdNode = kdNodeArray[kdNodeIndex];
-		const bool isLeafNode = (0xffffffff != kdNode._primitiveIndex);
-		if (true == isLeafNode)
-		{
-			float3 positions[] = {	getVertex(vertices, indices[kdNode._primitiveIndex * 3 + 0], stride),
-									getVertex(vertices, indices[kdNode._primitiveIndex * 3 + 1], stride) ,
-									getVertex(vertices, indices[kdNode._primitiveIndex * 3 + 2], stride) };
+		const KdBuildTask task = taskArray.back();
+		taskArray.pop_back();
 
-			PackedKdNode primitiveNode;
+		const uint32 beginIndex = task._beginIndex;
+		const uint32 endIndex = task._endIndex;
+		const uint32 nodeIndex = task._nodeIndex;
 
-			// Note(jinpark) : leaf node primitive primitiveǷ edge ͸  
-			float3 edge0 = positions[1] - positions[0];
+		const uint32 count = endIndex - beginIndex;
+		if (1 == count)
+		{
+			const uint32 primitiveIndex = primitiveArray._primitiveIndexArray[beginIndex];
 
-			// Note(jinpark) : packed data ũⰡ 16byte, primitive position 0   2.
-			uint32 primitiveIndex = kdNode._primitiveIndex + kdNodeCount * 2;
+			IndexedKdNode& leafNode = outIndexedTree._nodeArray[nodeIndex];
+			for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			{
+				const uint32 vertexIndex = meshView.getVertexIndex(primitiveIndex * 3 + cornerIndex);
+				if (vertexRemapArray.size() <= vertexIndex)
+				{
+					vertexRemapArray.resize(vertexIndex + 1, 0xffffffff);
+				}
 
-			primitiveNode._parameter0 = edge0;	// Note(jinpark) : edge ƴ϶ position1 Ѱܵ ʳ?
-			primitiveNode._parameter1 = primitiveIndex;
-			packedNodeArray.push_back(primitiveNode);
+				if (0xffffffff == vertexRemapArray[vertexIndex])
+				{
+					vertexRemapArray[vertexIndex] = static_cast<uint32>(outIndexedTree._vertexArray.size());
+					outIndexedTree._vertexArray.push_back(meshView.getPosition(vertexIndex));
+				}
 
-			float3 edge1 = positions[2] - positions[0];
-			uint32 nextNodeIndex = kdNode._nextNodeIndex;
-			primitiveNode._parameter0 = edge1;
-			primitiveNode._parameter1 = nextNodeIndex;
-			packedNodeArray.push_back(primitiveNode);
+				leafNode._vertexIndices[cornerIndex] = vertexRemapArray[vertexIndex];
+			}
+			leafNode._parameter1 = primitiveIndex;
+			continue;
 		}
-		else
-		{
-			PackedKdNode newPackedKdNode;
-			newPackedKdNode._parameter0 = kdNode._bbMin;
-			newPackedKdNode._parameter1 = kdNode._primitiveIndex;
-			packedNodeArray.push_back(newPackedKdNode);
 
-			newPackedKdNode._parameter0 = kdNode._bbMax;
-			newPackedKdNode._parameter1 = kdNode._nextNodeIndex;
-			packedNodeArray.push_back(newPackedKdNode);
+		IndexedKdNode& node0 = outIndexedTree._nodeArray[nodeIndex + 0];
+		IndexedKdNode& node1 = outIndexedTree._nodeArray[nodeIndex + 1];
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			node0._bound[axisIndex] = task._bbMin[axisIndex];
+			node1._bound[axisIndex] = task._bbMax[axisIndex];
 		}
+		node0._parameter1 = 0xffffffff;
+		node1._parameter1 = task._nextNodeIndex;
+
+		const uint32 midIndex = splitPrimitiveArray(primitiveArray, beginIndex, endIndex, task._bbMin, task._bbMax);
+
+		KdBuildTask leftTask;
+		leftTask._beginIndex = beginIndex;
+		leftTask._endIndex = midIndex;
+		buildBoundBox(leftTask._bbMin, leftTask._bbMax, primitiveArray, beginIndex, midIndex);
+
+		KdBuildTask rightTask;
+		rightTask._beginIndex = midIndex;
+		rightTask._endIndex = endIndex;
+		buildBoundBox(rightTask._bbMin, rightTask._bbMax, primitiveArray, midIndex, endIndex);
+
+		// Note(jinpark) : same order as buildInternal, the node with the bigger area is visited first.
+		const bool isRightFirst = computeSurfaceArea(leftTask._bbMin, leftTask._bbMax) < computeSurfaceArea(rightTask._bbMin, rightTask._bbMax);
+		KdBuildTask& firstTask = (true == isRightFirst) ? rightTask : leftTask;
+		KdBuildTask& secondTask = (true == isRightFirst) ? leftTask : rightTask;
+
+		const uint32 secondNodeIndex = nodeIndex + 2 + getIndexedNodeCount(firstTask._endIndex - firstTask._beginIndex);
+		firstTask._nodeIndex = nodeIndex + 2;
+		firstTask._nextNodeIndex = secondNodeIndex;
+		secondTask._nodeIndex = secondNodeIndex;
+		secondTask._nextNodeIndex = task._nextNodeIndex;
+
+		taskArray.push_back(secondTask);
+		taskArray.push_back(firstTask);
 	}
+}
+
+void KdTree::buildPrimitiveArray(KdPrimitiveArray& outPrimitiveArray, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	KdTreeMeshView meshView;
+	meshView._vertices = vertices;
+	meshView._stride = stride;
+	meshView._indices = indices;
+	meshView._indexCount = indexCount;
+
+	buildPrimitiveArray(outPrimitiveArray, meshView);
+}
+
+void KdTree::buildPrimitiveArray(KdPrimitiveArray& outPrimitiveArray, const KdTreeMeshView& meshView)
+{
+	assert(0 == (meshView._indexCount % 3));
+	const uint32 primitiveCount = meshView._indexCount / 3;
+
+	outPrimitiveArray._bbMinArray.resize(primitiveCount);
+	outPrimitiveArray._bbMaxArray.resize(primitiveCount);
+	outPrimitiveArray._primitiveIndexArray.resize(primitiveCount);
 
 	for (uint32 primitiveIndex = 0; primitiveIndex < primitiveCount; ++primitiveIndex)
 	{
-		const float3 position0 = getVertex(vertices, indices[primitiveIndex * 3 + 0], stride);
-		
-		PackedKdNode packedData;
-		packedData._parameter0 = position0;
-		packedData._parameter1 = 0;
-		packedNodeArray.push_back(packedData);
+		float3 boxMin = float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength);
+		float3 boxMax = -boxMin;
+
+		// Note(jinpark) : positions are decoded here from the stored format, the bounds pass is the only full read of the mesh.
+		float3 positions[] = {	meshView.getCornerPosition(primitiveIndex, 0),
+								meshView.getCornerPosition(primitiveIndex, 1),
+								meshView.getCornerPosition(primitiveIndex, 2) };
+
+		for (uint32 i = 0; i < 3; ++i)
+		{
+			float3Min(boxMin, positions[i]);
+			float3Max(boxMax, positions[i]);
+		}
+
+		outPrimitiveArray._bbMinArray[primitiveIndex] = boxMin;
+		outPrimitiveArray._bbMaxArray[primitiveIndex] = boxMax;
+		outPrimitiveArray._primitiveIndexArray[primitiveIndex] = primitiveIndex;
+	}
+}
+
+static void buildRangeNodeArrayInternal(std::vector<RangeKdNode>& outNodeArray, KdPrimitiveArray& primitiveArray, const uint32 beginIndex, const uint32 endIndex, const uint32 maxLeafPrimitiveCount, uint32& leafCount)
+{
+	const uint32 nodeIndex = static_cast<uint32>(outNodeArray.size());
+
+	RangeKdNode newNode;
+	KdTree::buildBoundBox(newNode._bbMin, newNode._bbMax, primitiveArray, beginIndex, endIndex);
+
+	if ((endIndex - beginIndex) <= maxLeafPrimitiveCount)
+	{
+		newNode._primitiveIndex = leafCount++;
+		newNode._beginIndex = beginIndex;
+		newNode._endIndex = endIndex;
+		newNode._nextNodeIndex = nodeIndex + 1;
+		outNodeArray.push_back(newNode);
+		return;
+	}
+
+	outNodeArray.push_back(newNode);
+
+	const uint32 midIndex = KdTree::splitPrimitiveArray(primitiveArray, beginIndex, endIndex, newNode._bbMin, newNode._bbMax);
+
+	float3 leftBBMin, leftBBMax, rightBBMin, rightBBMax;
+	KdTree::buildBoundBox(leftBBMin, leftBBMax, primitiveArray, beginIndex, midIndex);
+	KdTree::buildBoundBox(rightBBMin, rightBBMax, primitiveArray, midIndex, endIndex);
+
+	// Note(jinpark) : same as buildInternal, the node with the bigger area is visited first.
+	if (computeSurfaceArea(leftBBMin, leftBBMax) < computeSurfaceArea(rightBBMin, rightBBMax))
+	{
+		buildRangeNodeArrayInternal(outNodeArray, primitiveArray, midIndex, endIndex, maxLeafPrimitiveCount, leafCount);
+		buildRangeNodeArrayInternal(outNodeArray, primitiveArray, beginIndex, midIndex, maxLeafPrimitiveCount, leafCount);
+	}
+	else
+	{
+		buildRangeNodeArrayInternal(outNodeArray, primitiveArray, beginIndex, midIndex, maxLeafPrimitiveCount, leafCount);
+		buildRangeNodeArrayInternal(outNodeArray, primitiveArray, midIndex, endIndex, maxLeafPrimitiveCount, leafCount);
+	}
+
+	// Note(jinpark) : pre-order layout, the node right after the subtree is the skip target.
+	outNodeArray[nodeIndex]._nextNodeIndex = static_cast<uint32>(outNodeArray.size());
+}
+
+void KdTree::buildRangeNodeArray(std::vector<RangeKdNode>& outNodeArray, KdPrimitiveArray& primitiveArray, const uint32 maxLeafPrimitiveCount)
+{
+	assert(0 < maxLeafPrimitiveCount);
+	outNodeArray.clear();
+
+	const uint32 primitiveCount = primitiveArray.getCount();
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	uint32 leafCount = 0;
+	buildRangeNodeArrayInternal(outNodeArray, primitiveArray, 0, primitiveCount, maxLeafPrimitiveCount, leafCount);
+
+	const uint32 nodeCount = static_cast<uint32>(outNodeArray.size());
+	for (RangeKdNode& node : outNodeArray)
+	{
+		if (nodeCount == node._nextNodeIndex)
+		{
+			node._nextNodeIndex = 0xffffffff;
+		}
 	}
+}
 
-	outPackedNodeArray = static_cast<std::vector<PackedKdNode>&&>(packedNodeArray);
+void KdTreeBuildContext::reserve(const uint32 primitiveCount)
+{
+	_primitiveArray._bbMinArray.reserve(primitiveCount);
+	_primitiveArray._bbMaxArray.reserve(primitiveCount);
+	_primitiveArray._primitiveIndexArray.reserve(primitiveCount);
+	_primitiveArray._sortKeyArray.reserve(primitiveCount);
+	_primitiveArray._buildTaskArray.reserve(64);
+	_packedNodeArray.reserve(KdTree::getPackedNodeCount(primitiveCount));
+}
+
+void KdTreeBuildContext::shrink()
+{
+	_primitiveArray = KdPrimitiveArray();
+	_packedNodeArray = std::vector<PackedKdNode>();
+}
+
+uint32 KdTree::getPackedNodeCount(const uint32 primitiveCount)
+{
+	// Note(jinpark) : (primitiveCount * 2 - 1) nodes, 2 packed data per node, and position0 per primitive.
+	return (0 == primitiveCount) ? 0 : (primitiveCount * 5 - 2);
+}
+
+uint32 KdTree::getLeafNodeCount(const uint32 primitiveCount)
+{
+	// Note(jinpark) : (primitiveCount - 1) internal nodes of 2 and primitiveCount leaves of 3.
+	return (0 == primitiveCount) ? 0 : (primitiveCount * 5 - 2);
+}
+
+uint32 KdTree::getQuadNodeCount(const uint32 quadCount)
+{
+	// Note(jinpark) : (quadCount - 1) internal nodes of 2 and quadCount leaves of 4.
+	return (0 == quadCount) ? 0 : (quadCount * 6 - 2);
+}
+
+uint32 KdTree::getIndexedNodeCount(const uint32 primitiveCount)
+{
+	// Note(jinpark) : (primitiveCount - 1) internal nodes of 2 and primitiveCount leaves of 1.
+	return (0 == primitiveCount) ? 0 : (primitiveCount * 3 - 2);
+}
+
+void KdTree::build(std::vector<PackedKdNode>& outPackedNodeArray, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	assert(0 == (indexCount % 3));
+
+	outPackedNodeArray.resize(getPackedNodeCount(indexCount / 3));
+	build(outPackedNodeArray.data(), vertices, stride, indices, indexCount);
+}
+
+void KdTree::build(PackedKdNode* outPackedNodes, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	assert(0 == (indexCount % 3));
+
+	KdTreeMeshView meshView;
+	meshView._vertices = vertices;
+	meshView._stride = stride;
+	meshView._indices = indices;
+	meshView._indexCount = indexCount;
+
+	build(outPackedNodes, meshView);
+}
+
+void KdTree::build(std::vector<PackedKdNode>& outPackedNodeArray, const KdTreeMeshView& meshView)
+{
+	assert(0 == (meshView._indexCount % 3));
+
+	outPackedNodeArray.resize(getPackedNodeCount(meshView._indexCount / 3));
+	build(outPackedNodeArray.data(), meshView);
+}
+
+void KdTree::build(PackedKdNode* outPackedNodes, const KdTreeMeshView& meshView)
+{
+	assert(0 == (meshView._indexCount % 3));
+
+	buildPackedNode(outPackedNodes, _buildContext._primitiveArray, meshView);
+}
+
+void KdTree::build(KdTreeBuildContext& context, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	assert(0 == (indexCount % 3));
+
+	KdTreeMeshView meshView;
+	meshView._vertices = vertices;
+	meshView._stride = stride;
+	meshView._indices = indices;
+	meshView._indexCount = indexCount;
+
+	context._packedNodeArray.resize(getPackedNodeCount(indexCount / 3));
+	buildPackedNode(context._packedNodeArray.data(), context._primitiveArray, meshView);
+}
+
+void KdTree::build(std::vector<PackedKdNode>& outPackedNodeArray, std::vector<uint32>& outPrimitiveRemap, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	build(outPackedNodeArray, vertices, stride, indices, indexCount);
+	reorderPrimitives(outPrimitiveRemap, outPackedNodeArray.data(), static_cast<uint32>(outPackedNodeArray.size()));
+}
+
+void KdTree::reorderPrimitives(std::vector<uint32>& outPrimitiveRemap, PackedKdNode* packedNodes, const uint32 packedNodeCount)
+{
+	// Note(jinpark) : packed size = kdNodeCount * 2 + primitiveCount, kdNodeCount = primitiveCount * 2 - 1
+	const uint32 primitiveCount = (0 == packedNodeCount) ? 0 : ((packedNodeCount + 2) / 5);
+	outPrimitiveRemap.resize(primitiveCount);
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	const uint32 kdNodeCount = primitiveCount * 2 - 1;
+	const uint32 primitiveOffset = kdNodeCount * 2;
+
+	const std::vector<PackedKdNode> positionArray(packedNodes + primitiveOffset, packedNodes + packedNodeCount);
+
+	uint32 leafIndex = 0;
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		PackedKdNode& packedNode0 = packedNodes[nodeIndex * 2];
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+		if (false == isLeafNode)
+		{
+			continue;
+		}
+
+		const uint32 primitiveIndex = packedNode0._parameter1 - primitiveOffset;
+
+		// Note(jinpark) : the source index moves with its entry, so a second call keeps the link to the source primitive.
+		PackedKdNode& position0 = packedNodes[primitiveOffset + leafIndex];
+		position0 = positionArray[primitiveIndex];
+
+		packedNode0._parameter1 = primitiveOffset + leafIndex;
+		outPrimitiveRemap[leafIndex] = position0._parameter1;
+		++leafIndex;
+	}
+
+	assert(primitiveCount == leafIndex);
+}
+
+void KdTree::build(IndexedKdTree& outIndexedTree, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	assert(0 == (indexCount % 3));
+
+	KdTreeMeshView meshView;
+	meshView._vertices = vertices;
+	meshView._stride = stride;
+	meshView._indices = indices;
+	meshView._indexCount = indexCount;
+
+	const uint32 primitiveCount = indexCount / 3;
+	outIndexedTree._nodeArray.resize(getIndexedNodeCount(primitiveCount));
+	outIndexedTree._vertexArray.clear();
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	KdPrimitiveArray& primitiveArray = _buildContext._primitiveArray;
+	buildPrimitiveArray(primitiveArray, vertices, stride, indices, indexCount);
+
+	float3 bbMin, bbMax;
+	buildBoundBox(bbMin, bbMax, primitiveArray, 0, primitiveCount);
+	buildIndexedInternal(outIndexedTree, primitiveArray, meshView, bbMin, bbMax);
+}
+
+void KdTree::build(HalfKdTree& outHalfTree, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	assert(0 == (indexCount % 3));
+
+	std::vector<PackedKdNode>& packedNodeArray = _buildContext._packedNodeArray;
+	packedNodeArray.resize(getPackedNodeCount(indexCount / 3));
+
+	build(packedNodeArray.data(), vertices, stride, indices, indexCount);
+	buildHalfTree(outHalfTree, packedNodeArray.data(), static_cast<uint32>(packedNodeArray.size()));
+}
+
+void KdTree::buildHalfTree(HalfKdTree& outHalfTree, const PackedKdNode* packedNodes, const uint32 packedNodeCount)
+{
+	const uint32 primitiveCount = (0 == packedNodeCount) ? 0 : ((packedNodeCount + 2) / 5);
+	const uint32 kdNodeCount = (0 == primitiveCount) ? 0 : (primitiveCount * 2 - 1);
+
+	// Note(jinpark) : 1 step - node index in the half layout, pre-order with padding. an internal node that would
+	//				   share its block with a box more than kHalfKdBlockExtentRatio times its size starts the next
+	//				   block instead, a padding node takes its place and jumps there.
+	std::vector<uint32> halfIndexArray(kdNodeCount + 1);
+	std::vector<uint32> paddingIndexArray;
+	std::vector<float3> blockMinArray;
+	std::vector<float3> blockMaxArray;
+
+	uint32 halfIndex = 0;
+	float blockMinExtent = 0.0f;
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const bool isLeafNode = (0xffffffff != packedNodes[nodeIndex * 2]._parameter1);
+		if (true == isLeafNode)
+		{
+			halfIndexArray[nodeIndex] = halfIndex;
+			halfIndex += 2;
+			continue;
+		}
+
+		const float3& bbMin = packedNodes[nodeIndex * 2 + 0]._parameter0;
+		const float3& bbMax = packedNodes[nodeIndex * 2 + 1]._parameter0;
+		const float extent = getMaxExtent(bbMin, bbMax);
+
+		uint32 blockIndex = halfIndex / kHalfKdBlockSize;
+		if (blockIndex < blockMinArray.size())
+		{
+			float3 unionMin = blockMinArray[blockIndex];
+			float3 unionMax = blockMaxArray[blockIndex];
+			float3Min(unionMin, bbMin);
+			float3Max(unionMax, bbMax);
+
+			if (getMaxExtent(unionMin, unionMax) <= kHalfKdBlockExtentRatio * std::min(blockMinExtent, extent))
+			{
+				blockMinArray[blockIndex] = unionMin;
+				blockMaxArray[blockIndex] = unionMax;
+				blockMinExtent = std::min(blockMinExtent, extent);
+
+				halfIndexArray[nodeIndex] = halfIndex;
+				halfIndex += 1;
+				continue;
+			}
+
+			paddingIndexArray.push_back(halfIndex);
+			halfIndex = (blockIndex + 1) * kHalfKdBlockSize;
+			blockIndex += 1;
+		}
+
+		// Note(jinpark) : blocks of leaves only are left with an empty bound.
+		blockMinArray.resize(blockIndex + 1, float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength));
+		blockMaxArray.resize(blockIndex + 1, float3(-kMaxBoxLength, -kMaxBoxLength, -kMaxBoxLength));
+		blockMinArray[blockIndex] = bbMin;
+		blockMaxArray[blockIndex] = bbMax;
+		blockMinExtent = extent;
+
+		halfIndexArray[nodeIndex] = halfIndex;
+		halfIndex += 1;
+	}
+	halfIndexArray[kdNodeCount] = halfIndex;
+
+	const uint32 halfNodeCount = halfIndex;
+	const uint32 blockCount = (halfNodeCount + kHalfKdBlockSize - 1) / kHalfKdBlockSize;
+	blockMinArray.resize(blockCount, float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength));
+	blockMaxArray.resize(blockCount, float3(-kMaxBoxLength, -kMaxBoxLength, -kMaxBoxLength));
+
+	outHalfTree._nodeArray.resize(halfNodeCount);
+	outHalfTree._blockArray.resize(blockCount);
+	outHalfTree._positionArray.resize(primitiveCount);
+
+	auto toHalfIndex = [&halfIndexArray, kdNodeCount](uint32 nodeIndex)
+	{
+		return halfIndexArray[(0xffffffff == nodeIndex) ? kdNodeCount : nodeIndex];
+	};
+
+	// Note(jinpark) : 2 step - block origin and scale from the internal nodes of the block.
+	//				   deltas are kept under 2^14, well inside the half range.
+	for (uint32 blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+	{
+		HalfKdBlock& block = outHalfTree._blockArray[blockIndex];
+		block._origin = blockMinArray[blockIndex];
+
+		const float3 extents = blockMaxArray[blockIndex] - block._origin;
+		const float maxExtent = std::max(extents.x, std::max(extents.y, extents.z));
+		if (maxExtent < 0.0f)
+		{
+			// Note(jinpark) : leaves only
+			block._origin = float3(0.0f, 0.0f, 0.0f);
+			block._scale = 1.0f;
+			continue;
+		}
+
+		int exponent = 0;
+		frexpf(maxExtent / 16384.0f, &exponent);
+		block._scale = ldexpf(1.0f, exponent);
+	}
+
+	// Note(jinpark) : padding is an empty bound (+inf, -inf), every ray misses it and goes on to the node after the padding.
+	for (const uint32 paddingIndex : paddingIndexArray)
+	{
+		HalfKdNode& paddingNode = outHalfTree._nodeArray[paddingIndex];
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			paddingNode._bound[axisIndex + 0] = kHalfPositiveInfinity;
+			paddingNode._bound[axisIndex + 3] = kHalfNegativeInfinity;
+		}
+		paddingNode._parameter1 = (paddingIndex / kHalfKdBlockSize + 1) * kHalfKdBlockSize;
+	}
+
+	// Note(jinpark) : 3 step - nodes and position table
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const PackedKdNode& packedNode0 = packedNodes[nodeIndex * 2 + 0];
+		const PackedKdNode& packedNode1 = packedNodes[nodeIndex * 2 + 1];
+
+		const uint32 halfNodeIndex = halfIndexArray[nodeIndex];
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+		if (true == isLeafNode)
+		{
+			const uint32 primitiveIndex = packedNode0._parameter1 - kdNodeCount * 2;
+
+			HalfKdNode& halfNode0 = outHalfTree._nodeArray[halfNodeIndex + 0];
+			HalfKdNode& halfNode1 = outHalfTree._nodeArray[halfNodeIndex + 1];
+			for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+			{
+				halfNode0._edge[axisIndex] = packedNode0._parameter0[axisIndex];
+				halfNode1._edge[axisIndex] = packedNode1._parameter0[axisIndex];
+			}
+			halfNode0._parameter1 = kHalfKdLeafFlag | primitiveIndex;
+			halfNode1._parameter1 = 0;
+
+			outHalfTree._positionArray[primitiveIndex] = packedNodes[packedNode0._parameter1]._parameter0;
+			continue;
+		}
+
+		const HalfKdBlock& block = outHalfTree._blockArray[halfNodeIndex / kHalfKdBlockSize];
+
+		HalfKdNode& halfNode = outHalfTree._nodeArray[halfNodeIndex];
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			halfNode._bound[axisIndex + 0] = encodeHalfBound(packedNode0._parameter0[axisIndex], block._origin[axisIndex], block._scale, false);
+			halfNode._bound[axisIndex + 3] = encodeHalfBound(packedNode1._parameter0[axisIndex], block._origin[axisIndex], block._scale, true);
+		}
+		halfNode._parameter1 = toHalfIndex(packedNode1._parameter1);
+	}
+}
+
+void KdTree::build(LeafKdTree& outLeafTree, const KdTreeLeafEncoding leafEncoding, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	assert(0 == (indexCount % 3));
+
+	const uint32 primitiveCount = indexCount / 3;
+	assert(primitiveCount <= (1u << 30));
+
+	std::vector<PackedKdNode>& packedNodeArray = _buildContext._packedNodeArray;
+	packedNodeArray.resize(getPackedNodeCount(primitiveCount));
+	build(packedNodeArray.data(), vertices, stride, indices, indexCount);
+
+	outLeafTree._leafEncoding = leafEncoding;
+	outLeafTree._nodeArray.resize(getLeafNodeCount(primitiveCount));
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	// Note(jinpark) : 1 step - node index in the leaf layout, both layouts are pre-order so it is a running sum.
+	const uint32 kdNodeCount = primitiveCount * 2 - 1;
+	std::vector<uint32> leafIndexArray(kdNodeCount + 1);
+
+	uint32 leafIndex = 0;
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const bool isLeafNode = (0xffffffff != packedNodeArray[nodeIndex * 2]._parameter1);
+
+		leafIndexArray[nodeIndex] = leafIndex;
+		leafIndex += (true == isLeafNode) ? 3 : 2;
+	}
+	leafIndexArray[kdNodeCount] = leafIndex;
+
+	// Note(jinpark) : 2 step - copy internal nodes, leaves are encoded from the source vertices
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const PackedKdNode& packedNode0 = packedNodeArray[nodeIndex * 2 + 0];
+		const PackedKdNode& packedNode1 = packedNodeArray[nodeIndex * 2 + 1];
+
+		PackedKdNode* outNodes = outLeafTree._nodeArray.data() + leafIndexArray[nodeIndex];
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+		if (false == isLeafNode)
+		{
+			outNodes[0] = packedNode0;
+			outNodes[1]._parameter0 = packedNode1._parameter0;
+			outNodes[1]._parameter1 = leafIndexArray[(0xffffffff == packedNode1._parameter1) ? kdNodeCount : packedNode1._parameter1];
+			continue;
+		}
+
+		const uint32 primitiveIndex = packedNode0._parameter1 - kdNodeCount * 2;
+		const float3 positions[] = {	getVertex(vertices, indices[primitiveIndex * 3 + 0], stride),
+										getVertex(vertices, indices[primitiveIndex * 3 + 1], stride),
+										getVertex(vertices, indices[primitiveIndex * 3 + 2], stride) };
+
+		if (KdTreeLeafEncoding::Woop == leafEncoding)
+		{
+			buildWoopLeaf(outNodes, positions[0], positions[1], positions[2], primitiveIndex);
+		}
+		else
+		{
+			for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			{
+				outNodes[cornerIndex]._parameter0 = positions[cornerIndex];
+				outNodes[cornerIndex]._parameter1 = (0 == cornerIndex) ? primitiveIndex : 0;
+			}
+		}
+	}
+}
+
+void KdTree::build(SegmentedKdTree& outSegmentedTree, const void* vertices, uint32 stride, const uint32* indices, const uint64 indexCount, const uint32 maxSegmentPrimitiveCount)
+{
+	assert(0 == (indexCount % 3));
+	assert((0 < maxSegmentPrimitiveCount) && (maxSegmentPrimitiveCount <= kMaxSegmentPrimitiveCount));
+
+	const uint64 primitiveCount = indexCount / 3;
+
+	outSegmentedTree._topNodeArray.clear();
+	outSegmentedTree._segmentArray.clear();
+	outSegmentedTree._primitiveIndexArray.resize(primitiveCount);
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	// Note(jinpark) : 1 step - primitive center
+	std::vector<float3> centerArray(primitiveCount);
+	for (uint64 primitiveIndex = 0; primitiveIndex < primitiveCount; ++primitiveIndex)
+	{
+		float3 boxMin = getVertex(vertices, indices[primitiveIndex * 3 + 0], stride);
+		float3 boxMax = boxMin;
+		for (uint32 cornerIndex = 1; cornerIndex < 3; ++cornerIndex)
+		{
+			const float3 position = getVertex(vertices, indices[primitiveIndex * 3 + cornerIndex], stride);
+			float3Min(boxMin, position);
+			float3Max(boxMax, position);
+		}
+
+		centerArray[primitiveIndex] = (boxMin + boxMax) * 0.5f;
+		outSegmentedTree._primitiveIndexArray[primitiveIndex] = primitiveIndex;
+	}
+
+	// Note(jinpark) : 2 step - split at the object median of the longest center axis until every range fits a segment.
+	//				   ranges come out left to right, so segments are contiguous in _primitiveIndexArray.
+	std::vector<uint64>& orderArray = outSegmentedTree._primitiveIndexArray;
+	std::vector<std::pair<uint64, uint64>> rangeStack(1, std::make_pair(0ull, primitiveCount));
+	std::vector<std::pair<uint64, uint64>> segmentRangeArray;
+
+	while (false == rangeStack.empty())
+	{
+		const std::pair<uint64, uint64> range = rangeStack.back();
+		rangeStack.pop_back();
+
+		if ((range.second - range.first) <= maxSegmentPrimitiveCount)
+		{
+			segmentRangeArray.push_back(range);
+			continue;
+		}
+
+		float3 centerMin = centerArray[orderArray[range.first]];
+		float3 centerMax = centerMin;
+		for (uint64 orderIndex = range.first + 1; orderIndex < range.second; ++orderIndex)
+		{
+			float3Min(centerMin, centerArray[orderArray[orderIndex]]);
+			float3Max(centerMax, centerArray[orderArray[orderIndex]]);
+		}
+
+		const float3 extents = centerMax - centerMin;
+		const uint32 axisIndex = (extents.y < extents.x) ? ((extents.z < extents.x) ? 0 : 2) : ((extents.z < extents.y) ? 1 : 2);
+
+		const uint64 midIndex = range.first + (range.second - range.first) / 2;
+		std::nth_element(orderArray.begin() + range.first, orderArray.begin() + midIndex, orderArray.begin() + range.second,
+			[&centerArray, axisIndex](const uint64 lhs, const uint64 rhs) { return centerArray[lhs][axisIndex] < centerArray[rhs][axisIndex]; });
+
+		rangeStack.push_back(std::make_pair(midIndex, range.second));
+		rangeStack.push_back(std::make_pair(range.first, midIndex));
+	}
+
+	centerArray = std::vector<float3>();
+
+	// Note(jinpark) : 3 step - build every segment with the packed build, the vertex buffer is shared
+	const uint32 segmentCount = static_cast<uint32>(segmentRangeArray.size());
+	outSegmentedTree._segmentArray.resize(segmentCount);
+
+	KdPrimitiveArray segmentPrimitiveArray;
+	segmentPrimitiveArray._bbMinArray.resize(segmentCount);
+	segmentPrimitiveArray._bbMaxArray.resize(segmentCount);
+	segmentPrimitiveArray._primitiveIndexArray.resize(segmentCount);
+
+	std::vector<uint32> segmentIndexArray;
+	for (uint32 segmentIndex = 0; segmentIndex < segmentCount; ++segmentIndex)
+	{
+		const uint64 beginIndex = segmentRangeArray[segmentIndex].first;
+		const uint32 segmentPrimitiveCount = static_cast<uint32>(segmentRangeArray[segmentIndex].second - beginIndex);
+
+		float3 bbMin = float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength);
+		float3 bbMax = -bbMin;
+
+		segmentIndexArray.resize(segmentPrimitiveCount * 3);
+		for (uint32 localIndex = 0; localIndex < segmentPrimitiveCount; ++localIndex)
+		{
+			const uint64 primitiveIndex = orderArray[beginIndex + localIndex];
+			for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			{
+				const uint32 vertexIndex = indices[primitiveIndex * 3 + cornerIndex];
+				segmentIndexArray[localIndex * 3 + cornerIndex] = vertexIndex;
+
+				const float3 position = getVertex(vertices, vertexIndex, stride);
+				float3Min(bbMin, position);
+				float3Max(bbMax, position);
+			}
+		}
+
+		KdTreeSegment& segment = outSegmentedTree._segmentArray[segmentIndex];
+		segment._primitiveBase = beginIndex;
+		build(segment._packedNodeArray, vertices, stride, segmentIndexArray.data(), segmentPrimitiveCount * 3);
+
+		segmentPrimitiveArray._bbMinArray[segmentIndex] = bbMin;
+		segmentPrimitiveArray._bbMaxArray[segmentIndex] = bbMax;
+		segmentPrimitiveArray._primitiveIndexArray[segmentIndex] = segmentIndex;
+	}
+
+	// Note(jinpark) : 4 step - top tree, one segment per leaf
+	std::vector<RangeKdNode> topNodeArray;
+	buildRangeNodeArray(topNodeArray, segmentPrimitiveArray, 1);
+
+	outSegmentedTree._topNodeArray.resize(topNodeArray.size() * 2);
+	for (uint32 topNodeIndex = 0; topNodeIndex < static_cast<uint32>(topNodeArray.size()); ++topNodeIndex)
+	{
+		const RangeKdNode& topNode = topNodeArray[topNodeIndex];
+		const bool isSegmentNode = (0xffffffff != topNode._beginIndex);
+
+		PackedKdNode* outNodes = outSegmentedTree._topNodeArray.data() + topNodeIndex * 2;
+		outNodes[0]._parameter0 = topNode._bbMin;
+		outNodes[0]._parameter1 = (true == isSegmentNode) ? segmentPrimitiveArray._primitiveIndexArray[topNode._beginIndex] : 0xffffffff;
+		outNodes[1]._parameter0 = topNode._bbMax;
+		outNodes[1]._parameter1 = topNode._nextNodeIndex;
+	}
+}
+
+void KdTree::build(MultiMeshKdTree& outMultiMeshTree, const std::vector<KdTreeMeshView>& meshViewArray)
+{
+	const uint32 geometryCount = static_cast<uint32>(meshViewArray.size());
+
+	// Note(jinpark) : 1 step - global primitive index of every geometry
+	outMultiMeshTree._primitiveBaseArray.resize(geometryCount);
+
+	uint64 primitiveCount = 0;
+	for (uint32 geometryIndex = 0; geometryIndex < geometryCount; ++geometryIndex)
+	{
+		assert(0 == (meshViewArray[geometryIndex]._indexCount % 3));
+
+		outMultiMeshTree._primitiveBaseArray[geometryIndex] = static_cast<uint32>(primitiveCount);
+		primitiveCount += meshViewArray[geometryIndex]._indexCount / 3;
+	}
+	assert(primitiveCount <= kMaxSegmentPrimitiveCount);
+
+	outMultiMeshTree._packedNodeArray.resize(getPackedNodeCount(static_cast<uint32>(primitiveCount)));
+	outMultiMeshTree._geometryIndexArray.resize(primitiveCount);
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	// Note(jinpark) : 2 step - primitive bound, each geometry is read through its own view
+	KdPrimitiveArray& primitiveArray = _buildContext._primitiveArray;
+	primitiveArray._bbMinArray.resize(primitiveCount);
+	primitiveArray._bbMaxArray.resize(primitiveCount);
+	primitiveArray._primitiveIndexArray.resize(primitiveCount);
+
+	std::vector<uint32>& geometryIndexArray = outMultiMeshTree._geometryIndexArray;
+	for (uint32 geometryIndex = 0; geometryIndex < geometryCount; ++geometryIndex)
+	{
+		const KdTreeMeshView& meshView = meshViewArray[geometryIndex];
+		const uint32 primitiveBase = outMultiMeshTree._primitiveBaseArray[geometryIndex];
+
+		for (uint32 localIndex = 0; localIndex < meshView._indexCount / 3; ++localIndex)
+		{
+			float3 boxMin = meshView.getCornerPosition(localIndex, 0);
+			float3 boxMax = boxMin;
+			for (uint32 cornerIndex = 1; cornerIndex < 3; ++cornerIndex)
+			{
+				const float3 position = meshView.getCornerPosition(localIndex, cornerIndex);
+				float3Min(boxMin, position);
+				float3Max(boxMax, position);
+			}
+
+			const uint32 primitiveIndex = primitiveBase + localIndex;
+			primitiveArray._bbMinArray[primitiveIndex] = boxMin;
+			primitiveArray._bbMaxArray[primitiveIndex] = boxMax;
+			primitiveArray._primitiveIndexArray[primitiveIndex] = primitiveIndex;
+			geometryIndexArray[primitiveIndex] = geometryIndex;
+		}
+	}
+
+	// Note(jinpark) : 3 step - build node. range nodes are pre-order with one primitive per leaf, so node i is packed node i.
+	std::vector<RangeKdNode> rangeNodeArray;
+	buildRangeNodeArray(rangeNodeArray, primitiveArray, 1);
+
+	const uint32 kdNodeCount = static_cast<uint32>(rangeNodeArray.size());
+	assert(kdNodeCount == primitiveCount * 2 - 1);
+
+	PackedKdNode* outPackedNodes = outMultiMeshTree._packedNodeArray.data();
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const RangeKdNode& rangeNode = rangeNodeArray[nodeIndex];
+
+		PackedKdNode& packedNode0 = outPackedNodes[nodeIndex * 2 + 0];
+		PackedKdNode& packedNode1 = outPackedNodes[nodeIndex * 2 + 1];
+		packedNode1._parameter1 = rangeNode._nextNodeIndex;
+
+		const bool isLeafNode = (0xffffffff != rangeNode._beginIndex);
+		if (false == isLeafNode)
+		{
+			packedNode0._parameter0 = rangeNode._bbMin;
+			packedNode0._parameter1 = 0xffffffff;
+			packedNode1._parameter0 = rangeNode._bbMax;
+			continue;
+		}
+
+		const uint32 primitiveIndex = primitiveArray._primitiveIndexArray[rangeNode._beginIndex];
+		const uint32 geometryIndex = geometryIndexArray[primitiveIndex];
+		const uint32 localIndex = primitiveIndex - outMultiMeshTree._primitiveBaseArray[geometryIndex];
+		const KdTreeMeshView& meshView = meshViewArray[geometryIndex];
+
+		const float3 positions[] = {	meshView.getCornerPosition(localIndex, 0),
+										meshView.getCornerPosition(localIndex, 1),
+										meshView.getCornerPosition(localIndex, 2) };
+
+		packedNode0._parameter0 = positions[1] - positions[0];
+		packedNode0._parameter1 = primitiveIndex + kdNodeCount * 2;
+		packedNode1._parameter0 = positions[2] - positions[0];
+
+		// Note(jinpark) : 4 step - position0 table, _parameter1 is the global source index as in every packed build
+		PackedKdNode& position0 = outPackedNodes[kdNodeCount * 2 + primitiveIndex];
+		position0._parameter0 = positions[0];
+		position0._parameter1 = primitiveIndex;
+	}
+}
+
+void KdTree::build(MotionKdTree& outMotionTree, const KdTreeMeshView& meshView, const void* vertices1)
+{
+	assert(0 == (meshView._indexCount % 3));
+	const uint32 primitiveCount = meshView._indexCount / 3;
+
+	outMotionTree._nodeArray.clear();
+	outMotionTree._positionArray.clear();
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	KdTreeMeshView meshView1 = meshView;
+	meshView1._vertices = vertices1;
+
+	// Note(jinpark) : 1 step - primitive bound over both keyframes, the bound of a linear motion is the union of its ends
+	KdPrimitiveArray& primitiveArray = _buildContext._primitiveArray;
+	primitiveArray._bbMinArray.resize(primitiveCount);
+	primitiveArray._bbMaxArray.resize(primitiveCount);
+	primitiveArray._primitiveIndexArray.resize(primitiveCount);
+
+	for (uint32 primitiveIndex = 0; primitiveIndex < primitiveCount; ++primitiveIndex)
+	{
+		float3 boxMin = meshView.getCornerPosition(primitiveIndex, 0);
+		float3 boxMax = boxMin;
+		for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			const float3 position0 = meshView.getCornerPosition(primitiveIndex, cornerIndex);
+			const float3 position1 = meshView1.getCornerPosition(primitiveIndex, cornerIndex);
+			float3Min(boxMin, position0);
+			float3Max(boxMax, position0);
+			float3Min(boxMin, position1);
+			float3Max(boxMax, position1);
+		}
+
+		primitiveArray._bbMinArray[primitiveIndex] = boxMin;
+		primitiveArray._bbMaxArray[primitiveIndex] = boxMax;
+		primitiveArray._primitiveIndexArray[primitiveIndex] = primitiveIndex;
+	}
+
+	// Note(jinpark) : 2 step - build node, one primitive per leaf
+	std::vector<RangeKdNode> rangeNodeArray;
+	buildRangeNodeArray(rangeNodeArray, primitiveArray, 1);
+
+	const uint32 kdNodeCount = static_cast<uint32>(rangeNodeArray.size());
+	outMotionTree._nodeArray.resize(kdNodeCount * 4);
+	outMotionTree._positionArray.resize(primitiveCount * 2);
+
+	// Note(jinpark) : 3 step - refit at each keyframe. children come after their parent in pre-order, so a reverse
+	//				   pass sees both children first. the right child is where the left subtree ends.
+	std::vector<float3> bbMinArray(kdNodeCount * 2), bbMaxArray(kdNodeCount * 2);
+	for (uint32 nodeIndex = kdNodeCount; 0 < nodeIndex--; )
+	{
+		const RangeKdNode& rangeNode = rangeNodeArray[nodeIndex];
+
+		PackedKdNode* packedNodes = &outMotionTree._nodeArray[nodeIndex * 4];
+		packedNodes[1]._parameter1 = rangeNode._nextNodeIndex;
+		packedNodes[2]._parameter1 = 0;
+		packedNodes[3]._parameter1 = 0;
+
+		const bool isLeafNode = (0xffffffff != rangeNode._beginIndex);
+		if (true == isLeafNode)
+		{
+			const uint32 primitiveIndex = primitiveArray._primitiveIndexArray[rangeNode._beginIndex];
+			packedNodes[0]._parameter1 = primitiveIndex;
+
+			for (uint32 keyIndex = 0; keyIndex < 2; ++keyIndex)
+			{
+				const KdTreeMeshView& keyMeshView = (0 == keyIndex) ? meshView : meshView1;
+				const float3 positions[] = {	keyMeshView.getCornerPosition(primitiveIndex, 0),
+												keyMeshView.getCornerPosition(primitiveIndex, 1),
+												keyMeshView.getCornerPosition(primitiveIndex, 2) };
+
+				packedNodes[keyIndex * 2 + 0]._parameter0 = positions[1] - positions[0];
+				packedNodes[keyIndex * 2 + 1]._parameter0 = positions[2] - positions[0];
+				outMotionTree._positionArray[primitiveIndex * 2 + keyIndex] = positions[0];
+
+				float3& bbMin = bbMinArray[nodeIndex * 2 + keyIndex];
+				float3& bbMax = bbMaxArray[nodeIndex * 2 + keyIndex];
+				bbMin = bbMax = positions[0];
+				float3Min(bbMin, positions[1]);
+				float3Max(bbMax, positions[1]);
+				float3Min(bbMin, positions[2]);
+				float3Max(bbMax, positions[2]);
+			}
+			continue;
+		}
+
+		const uint32 leftIndex = nodeIndex + 1;
+		const uint32 rightIndex = rangeNodeArray[leftIndex]._nextNodeIndex;
+
+		packedNodes[0]._parameter1 = 0xffffffff;
+		for (uint32 keyIndex = 0; keyIndex < 2; ++keyIndex)
+		{
+			float3& bbMin = bbMinArray[nodeIndex * 2 + keyIndex];
+			float3& bbMax = bbMaxArray[nodeIndex * 2 + keyIndex];
+			bbMin = bbMinArray[leftIndex * 2 + keyIndex];
+			bbMax = bbMaxArray[leftIndex * 2 + keyIndex];
+			float3Min(bbMin, bbMinArray[rightIndex * 2 + keyIndex]);
+			float3Max(bbMax, bbMaxArray[rightIndex * 2 + keyIndex]);
+
+			packedNodes[keyIndex * 2 + 0]._parameter0 = bbMin;
+			packedNodes[keyIndex * 2 + 1]._parameter0 = bbMax;
+		}
+	}
+}
+
+void KdTree::build(ShapeKdTree& outShapeTree, const uint32 primitiveCount, const std::function<void(float3&, float3&, const uint32)>& getBound)
+{
+	KdPrimitiveArray& primitiveArray = _buildContext._primitiveArray;
+	primitiveArray._bbMinArray.resize(primitiveCount);
+	primitiveArray._bbMaxArray.resize(primitiveCount);
+	primitiveArray._primitiveIndexArray.resize(primitiveCount);
+
+	for (uint32 primitiveIndex = 0; primitiveIndex < primitiveCount; ++primitiveIndex)
+	{
+		getBound(primitiveArray._bbMinArray[primitiveIndex], primitiveArray._bbMaxArray[primitiveIndex], primitiveIndex);
+		primitiveArray._primitiveIndexArray[primitiveIndex] = primitiveIndex;
+	}
+
+	buildShapeInternal(outShapeTree, KdShapeType::Box, nullptr);
+}
+
+void KdTree::build(ShapeKdTree& outShapeTree, const KdSphere* spheres, const uint32 sphereCount)
+{
+	KdPrimitiveArray& primitiveArray = _buildContext._primitiveArray;
+	primitiveArray._bbMinArray.resize(sphereCount);
+	primitiveArray._bbMaxArray.resize(sphereCount);
+	primitiveArray._primitiveIndexArray.resize(sphereCount);
+
+	std::vector<KdShape> shapeArray(sphereCount);
+	for (uint32 primitiveIndex = 0; primitiveIndex < sphereCount; ++primitiveIndex)
+	{
+		const KdSphere& sphere = spheres[primitiveIndex];
+		const float3 extents = float3(sphere._radius, sphere._radius, sphere._radius);
+
+		primitiveArray._bbMinArray[primitiveIndex] = sphere._center - extents;
+		primitiveArray._bbMaxArray[primitiveIndex] = sphere._center + extents;
+		primitiveArray._primitiveIndexArray[primitiveIndex] = primitiveIndex;
+
+		shapeArray[primitiveIndex]._position0 = sphere._center;
+		shapeArray[primitiveIndex]._radius = sphere._radius;
+		shapeArray[primitiveIndex]._position1 = sphere._center;
+	}
+
+	buildShapeInternal(outShapeTree, KdShapeType::Sphere, shapeArray.data());
+}
+
+void KdTree::build(ShapeKdTree& outShapeTree, const KdCapsule* capsules, const uint32 capsuleCount)
+{
+	KdPrimitiveArray& primitiveArray = _buildContext._primitiveArray;
+	primitiveArray._bbMinArray.resize(capsuleCount);
+	primitiveArray._bbMaxArray.resize(capsuleCount);
+	primitiveArray._primitiveIndexArray.resize(capsuleCount);
+
+	std::vector<KdShape> shapeArray(capsuleCount);
+	for (uint32 primitiveIndex = 0; primitiveIndex < capsuleCount; ++primitiveIndex)
+	{
+		const KdCapsule& capsule = capsules[primitiveIndex];
+		const float3 extents = float3(capsule._radius, capsule._radius, capsule._radius);
+
+		float3 bbMin = capsule._position0, bbMax = capsule._position0;
+		float3Min(bbMin, capsule._position1);
+		float3Max(bbMax, capsule._position1);
+
+		primitiveArray._bbMinArray[primitiveIndex] = bbMin - extents;
+		primitiveArray._bbMaxArray[primitiveIndex] = bbMax + extents;
+		primitiveArray._primitiveIndexArray[primitiveIndex] = primitiveIndex;
+
+		shapeArray[primitiveIndex]._position0 = capsule._position0;
+		shapeArray[primitiveIndex]._radius = capsule._radius;
+		shapeArray[primitiveIndex]._position1 = capsule._position1;
+	}
+
+	buildShapeInternal(outShapeTree, KdShapeType::Capsule, shapeArray.data());
+}
+
+void KdTree::buildShapeInternal(ShapeKdTree& outShapeTree, const KdShapeType shapeType, const KdShape* shapes)
+{
+	// Note(jinpark) : primitive bounds are already in _buildContext._primitiveArray, the hierarchy only looks at bounds.
+	KdPrimitiveArray& primitiveArray = _buildContext._primitiveArray;
+	const uint32 primitiveCount = primitiveArray.getCount();
+
+	outShapeTree._shapeType = shapeType;
+	outShapeTree._nodeArray.clear();
+	outShapeTree._shapeArray.clear();
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	std::vector<RangeKdNode> rangeNodeArray;
+	buildRangeNodeArray(rangeNodeArray, primitiveArray, 1);
+
+	const uint32 kdNodeCount = static_cast<uint32>(rangeNodeArray.size());
+	outShapeTree._nodeArray.resize(kdNodeCount * 2);
+	outShapeTree._shapeArray.reserve(primitiveCount);
+
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const RangeKdNode& rangeNode = rangeNodeArray[nodeIndex];
+
+		PackedKdNode& packedNode0 = outShapeTree._nodeArray[nodeIndex * 2 + 0];
+		PackedKdNode& packedNode1 = outShapeTree._nodeArray[nodeIndex * 2 + 1];
+		packedNode0._parameter0 = rangeNode._bbMin;
+		packedNode0._parameter1 = 0xffffffff;
+		packedNode1._parameter0 = rangeNode._bbMax;
+		packedNode1._parameter1 = rangeNode._nextNodeIndex;
+
+		const bool isLeafNode = (0xffffffff != rangeNode._beginIndex);
+		if (true == isLeafNode)
+		{
+			const uint32 primitiveIndex = primitiveArray._primitiveIndexArray[rangeNode._beginIndex];
+
+			KdShape shape = (nullptr != shapes) ? shapes[primitiveIndex] : KdShape();
+			shape._primitiveIndex = primitiveIndex;
+
+			packedNode0._parameter1 = static_cast<uint32>(outShapeTree._shapeArray.size());
+			outShapeTree._shapeArray.push_back(shape);
+		}
+	}
+}
+
+void KdTree::build(QuadKdTree& outQuadTree, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount)
+{
+	assert(0 == (indexCount % 3));
+
+	const uint32 primitiveCount = indexCount / 3;
+
+	outQuadTree._nodeArray.clear();
+	outQuadTree._quadCount = 0;
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	KdTreeMeshView meshView;
+	meshView._vertices = vertices;
+	meshView._stride = stride;
+	meshView._indices = indices;
+	meshView._indexCount = indexCount;
+
+	// Note(jinpark) : 1 step - pair triangles, a quad is (primitiveIndex0, primitiveIndex1)
+	std::vector<uint32> pairArray;
+	pairTriangles(pairArray, indices, primitiveCount);
+
+	std::vector<uint32> quadArray;
+	quadArray.reserve(primitiveCount * 2);
+	for (uint32 primitiveIndex = 0; primitiveIndex < primitiveCount; ++primitiveIndex)
+	{
+		const uint32 pairIndex = pairArray[primitiveIndex];
+		if ((0xffffffff == pairIndex) || (primitiveIndex < pairIndex))
+		{
+			quadArray.push_back(primitiveIndex);
+			quadArray.push_back(pairIndex);
+		}
+	}
+
+	const uint32 quadCount = static_cast<uint32>(quadArray.size() / 2);
+	outQuadTree._quadCount = quadCount;
+
+	// Note(jinpark) : 2 step - quad bound, the usual build runs over quads instead of triangles
+	KdPrimitiveArray& primitiveArray = _buildContext._primitiveArray;
+	buildPrimitiveArray(primitiveArray, vertices, stride, indices, indexCount);
+
+	std::vector<float3> quadBBMinArray(quadCount), quadBBMaxArray(quadCount);
+	for (uint32 quadIndex = 0; quadIndex < quadCount; ++quadIndex)
+	{
+		const uint32 primitiveIndex0 = quadArray[quadIndex * 2 + 0];
+		const uint32 primitiveIndex1 = quadArray[quadIndex * 2 + 1];
+
+		quadBBMinArray[quadIndex] = primitiveArray._bbMinArray[primitiveIndex0];
+		quadBBMaxArray[quadIndex] = primitiveArray._bbMaxArray[primitiveIndex0];
+		if (0xffffffff != primitiveIndex1)
+		{
+			float3Min(quadBBMinArray[quadIndex], primitiveArray._bbMinArray[primitiveIndex1]);
+			float3Max(quadBBMaxArray[quadIndex], primitiveArray._bbMaxArray[primitiveIndex1]);
+		}
+	}
+
+	primitiveArray._bbMinArray.swap(quadBBMinArray);
+	primitiveArray._bbMaxArray.swap(quadBBMaxArray);
+	primitiveArray._primitiveIndexArray.resize(quadCount);
+	for (uint32 quadIndex = 0; quadIndex < quadCount; ++quadIndex)
+	{
+		primitiveArray._primitiveIndexArray[quadIndex] = quadIndex;
+	}
+
+	std::vector<RangeKdNode> rangeNodeArray;
+	buildRangeNodeArray(rangeNodeArray, primitiveArray, 1);
+
+	// Note(jinpark) : 3 step - node index in the quad layout, pre-order so it is a running sum
+	const uint32 kdNodeCount = static_cast<uint32>(rangeNodeArray.size());
+	std::vector<uint32> quadNodeIndexArray(kdNodeCount + 1);
+
+	uint32 quadNodeIndex = 0;
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const bool isLeafNode = (0xffffffff != rangeNodeArray[nodeIndex]._beginIndex);
+
+		quadNodeIndexArray[nodeIndex] = quadNodeIndex;
+		quadNodeIndex += (true == isLeafNode) ? 4 : 2;
+	}
+	quadNodeIndexArray[kdNodeCount] = quadNodeIndex;
+	assert(getQuadNodeCount(quadCount) == quadNodeIndex);
+
+	// Note(jinpark) : 4 step - write nodes, leaves are encoded from the source vertices
+	outQuadTree._nodeArray.resize(quadNodeIndex);
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const RangeKdNode& rangeNode = rangeNodeArray[nodeIndex];
+		PackedKdNode* outNodes = outQuadTree._nodeArray.data() + quadNodeIndexArray[nodeIndex];
+
+		if (0xffffffff != rangeNode._beginIndex)
+		{
+			const uint32 quadIndex = primitiveArray._primitiveIndexArray[rangeNode._beginIndex];
+			buildQuadLeaf(outNodes, meshView, quadArray[quadIndex * 2 + 0], quadArray[quadIndex * 2 + 1]);
+			continue;
+		}
+
+		outNodes[0]._parameter0 = rangeNode._bbMin;
+		outNodes[0]._parameter1 = 0xffffffff;
+		outNodes[1]._parameter0 = rangeNode._bbMax;
+		outNodes[1]._parameter1 = quadNodeIndexArray[(0xffffffff == rangeNode._nextNodeIndex) ? kdNodeCount : rangeNode._nextNodeIndex];
+	}
+}
+
+void KdTree::buildPackedNode(PackedKdNode* outPackedNodes, KdPrimitiveArray& primitiveArray, const KdTreeMeshView& meshView)
+{
+	const uint32 primitiveCount = meshView._indexCount / 3;
+	if (0 == primitiveCount)
+	{
+		return;
+	}
+
+	KdTreeCacheKey cacheKey;
+	if (nullptr != _cache)
+	{
+		cacheKey = KdTreeCache::computeKey(meshView);
+		if (true == _cache->find(outPackedNodes, cacheKey))
+		{
+			return;
+		}
+	}
+
+	// Note(jinpark) : 1 step - build primitive bound
+	buildPrimitiveArray(primitiveArray, meshView);
+
+	// Note(jinpark) : 2 step - build node, written straight into the packed layout
+	float3 bbMin, bbMax;
+	buildBoundBox(bbMin, bbMax, primitiveArray, 0, primitiveCount);
+	buildInternal(outPackedNodes, primitiveArray, meshView, bbMin, bbMax);
+
+	// Note(jinpark) : 3 step - position0 table
+	const uint32 kdNodeCount = primitiveCount * 2 - 1;
+	for (uint32 primitiveIndex = 0; primitiveIndex < primitiveCount; ++primitiveIndex)
+	{
+		const float3 position0 = meshView.getCornerPosition(primitiveIndex, 0);
+
+		PackedKdNode packedData;
+		packedData._parameter0 = position0;
+		packedData._parameter1 = primitiveIndex;
+		outPackedNodes[kdNodeCount * 2 + primitiveIndex] = packedData;
+	}
+
+	if (nullptr != _cache)
+	{
+		_cache->insert(cacheKey, outPackedNodes);
+	}
 }
\ No newline at end of file
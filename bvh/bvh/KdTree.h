@@ -2,6 +2,7 @@
 
 #include "Common/Common.h"
 #include "float3.h"
+#include <functional>
 #include <vector>
 
 struct KdNode
@@ -13,38 +14,348 @@ struct KdNode
 	uint32 _nextNodeIndex = 0xffffffff;
 };
 
-struct RawKdNodeData : public KdNode
+struct KdSortKey
 {
-	float3 _center;
+	float _center2;
+	uint32 _primitiveIndex;
+};
+
+struct KdBuildTask
+{
+	uint32 _beginIndex;
+	uint32 _endIndex;
+	float3 _bbMin;
+	float3 _bbMax;
+	uint32 _nodeIndex;
+	uint32 _nextNodeIndex;
+};
 
-	uint32 _orderIndex = 0xffffffff;
-	uint32 _parentNodeIndex = 0xffffffff;
+// Note(jinpark) : build scratch, SoA. bounds are indexed by primitive index,
+//				   _primitiveIndexArray is the build order and gets sorted by the build.
+struct KdPrimitiveArray
+{
+	std::vector<float3> _bbMinArray;
+	std::vector<float3> _bbMaxArray;
+	std::vector<uint32> _primitiveIndexArray;
+	std::vector<KdSortKey> _sortKeyArray;
+	std::vector<KdBuildTask> _buildTaskArray;
 
-	uint32 _leftNodeIndex = 0xffffffff;
-	uint32 _rightNodeIndex = 0xffffffff;
+	uint32 getCount() const { return static_cast<uint32>(_primitiveIndexArray.size()); }
+};
 
-	float _primitiveArea = 0.0f;
-	float _surfaceAreaLeft = 0.0f;
-	float _surfaceAreaRight = 0.0f;
+struct RangeKdNode : public KdNode
+{
+	// Note(jinpark) : leaf node covers [_beginIndex, _endIndex) of the primitive build order, _primitiveIndex is leaf order.
+	uint32 _beginIndex = 0xffffffff;
+	uint32 _endIndex = 0xffffffff;
 };
 
+// Note(jinpark) : in the position0 table (after the 2 nodes per kd node) _parameter1 is always the source primitive index,
+//				   whatever the build. layouts that permute the table (reorderPrimitives, the stream builder) keep it that way.
 struct PackedKdNode
 {
 	float3	_parameter0;
 	uint32	_parameter1;
 };
 
+// Note(jinpark) : 16 bytes. internal node takes 2 (bbMin with 0xffffffff, bbMax with next node index),
+//				   leaf node takes 1 (vertex index triple with primitive index), a leaf is always followed by its next node.
+struct IndexedKdNode
+{
+	union
+	{
+		float _bound[3];
+		uint32 _vertexIndices[3];
+	};
+	uint32 _parameter1;
+};
+
+// Note(jinpark) : leaves reference _vertexArray instead of storing edges and position0,
+//				   it holds only the referenced vertices, in the order the leaves are laid out.
+struct IndexedKdTree
+{
+	std::vector<IndexedKdNode> _nodeArray;
+	std::vector<float3> _vertexArray;
+
+	size_t getByteCount() const { return _nodeArray.size() * sizeof(IndexedKdNode) + _vertexArray.size() * sizeof(float3); }
+};
+
+const uint32 kHalfKdBlockSize = 64;
+const uint32 kHalfKdLeafFlag = 0x80000000;
+
+// Note(jinpark) : 16 bytes. internal node takes 1 (half bounds relative to its block, next node index),
+//				   leaf node takes 2 (full precision edge0 with kHalfKdLeafFlag | primitiveIndex, edge1),
+//				   a leaf is always followed by its next node.
+struct HalfKdNode
+{
+	union
+	{
+		ushort _bound[6];	// Note(jinpark) : bbMin xyz, bbMax xyz
+		float _edge[3];
+	};
+	uint32 _parameter1;
+};
+static_assert(sizeof(HalfKdNode) == 16, "HalfKdNode must stay 16 bytes");
+
+// Note(jinpark) : bound = _origin + half * _scale, _scale is a power of two so the product is exact.
+struct HalfKdBlock
+{
+	float3 _origin;
+	float _scale;
+};
+
+// Note(jinpark) : node i decodes with _blockArray[i / kHalfKdBlockSize]. a block is a run of consecutive pre-order
+//				   nodes of similar size. a node whose size is far from the rest of its block starts the next block
+//				   instead, so small boxes are not quantized on the scale of a large one. the slots skipped are padding,
+//				   an internal node with an empty bound that jumps to the next block.
+struct HalfKdTree
+{
+	std::vector<HalfKdNode> _nodeArray;
+	std::vector<HalfKdBlock> _blockArray;
+	std::vector<float3> _positionArray;
+
+	size_t getByteCount() const { return _nodeArray.size() * sizeof(HalfKdNode) + _blockArray.size() * sizeof(HalfKdBlock) + _positionArray.size() * sizeof(float3); }
+};
+
+enum class KdTreeLeafEncoding : uint32
+{
+	// Note(jinpark) : 3x4 affine transform into unit triangle space. rows are (_parameter0, w),
+	//				   row 2 is divided by its component on axis k so only the other two are stored.
+	//				   leaf = (row0.xyz, (k << 30) | primitiveIndex), (row1.xyz, row0.w), (row2.ab + row2.w, row1.w)
+	Woop,
+
+	// Note(jinpark) : exact vertices for the watertight test, leaf = (position0, primitiveIndex), (position1, 0), (position2, 0)
+	Watertight,
+};
+
+// Note(jinpark) : same tree as the packed layout. internal node takes 2 as usual, leaf node takes 3,
+//				   a leaf is always followed by its next node and the last next node index is the node count.
+struct LeafKdTree
+{
+	KdTreeLeafEncoding _leafEncoding = KdTreeLeafEncoding::Woop;
+	std::vector<PackedKdNode> _nodeArray;
+};
+
+// Note(jinpark) : triangles sharing an edge are paired into one leaf with corners v0..v3, triangle 0 is (v0, v1, v2) and
+//				   triangle 1 is (v0, v2, v3). internal node takes 2 as usual, leaf node takes 4 laid out for one 4 wide test,
+//				   (d1.x, d2.x, d3.x, primitiveIndex0), (d1.y, d2.y, d3.y, primitiveIndex1), (d1.z, d2.z, d3.z, cornerCode), (v0, 0)
+//				   with dN = vN - v0. an unpaired triangle has primitiveIndex1 0xffffffff.
+//				   cornerCode maps back to the source winding, 4 bits per triangle, the lanes of source corner 1 and 2.
+struct QuadKdTree
+{
+	std::vector<PackedKdNode> _nodeArray;
+	uint32 _quadCount = 0;
+};
+
+// Note(jinpark) : packed indices are uint32, so one packed buffer holds at most kMaxSegmentPrimitiveCount primitives.
+const uint32 kMaxSegmentPrimitiveCount = static_cast<uint32>((0xffffffffull + 2) / 5);
+
+// Note(jinpark) : a usual packed tree over primitives [_primitiveBase, _primitiveBase + primitive count) of the segment order.
+struct KdTreeSegment
+{
+	std::vector<PackedKdNode> _packedNodeArray;
+	uint64 _primitiveBase = 0;
+};
+
+// Note(jinpark) : one tree over more primitives than a packed buffer can index. primitives are split spatially into segments,
+//				   each segment is its own packed buffer and a top tree over segment bounds ties them together.
+//				   top node takes 2, internal (bbMin, 0xffffffff), (bbMax, next), leaf (bbMin, segmentIndex), (bbMax, next).
+//				   _primitiveIndexArray[segment._primitiveBase + local primitive index] is the source primitive index.
+struct SegmentedKdTree
+{
+	std::vector<PackedKdNode> _topNodeArray;
+	std::vector<KdTreeSegment> _segmentArray;
+	std::vector<uint64> _primitiveIndexArray;
+};
+
+enum class KdTreeIndexFormat : uint32
+{
+	UInt32,
+	UInt16,
+	None,		// Note(jinpark) : triangle soup, corner i reads vertex i. _indices is ignored.
+};
+
+enum class KdTreeVertexFormat : uint32
+{
+	Float3,
+	Half3,
+	Snorm16x3,	// Note(jinpark) : int16 / 32767 clamped to -1, then _positionScale and _positionOffset
+	Unorm16x3,	// Note(jinpark) : uint16 / 65535, then _positionScale and _positionOffset
+};
+
+// Note(jinpark) : mesh as it is stored, converted while the build reads it. _indexCount is the corner count
+//				   (3 per triangle) for every index format. the default is float3 positions with uint32 indices.
+struct KdTreeMeshView
+{
+	const void* _vertices = nullptr;
+	uint32 _stride = 0;
+	const void* _indices = nullptr;
+	uint32 _indexCount = 0;
+
+	KdTreeIndexFormat _indexFormat = KdTreeIndexFormat::UInt32;
+	KdTreeVertexFormat _vertexFormat = KdTreeVertexFormat::Float3;
+	float3 _positionScale = float3(1.0f, 1.0f, 1.0f);
+	float3 _positionOffset = float3(0.0f, 0.0f, 0.0f);
+
+	uint32 getVertexIndex(const uint32 cornerIndex) const;
+	float3 getPosition(const uint32 vertexIndex) const;
+	float3 getCornerPosition(const uint32 primitiveIndex, const uint32 cornerIndex) const { return getPosition(getVertexIndex(primitiveIndex * 3 + cornerIndex)); }
+
+	uint32 getIndexByteCount() const;
+	uint32 getVertexByteCount() const;
+};
+
+// Note(jinpark) : one packed tree over several meshes, the layout is the usual packed one over global primitive indices
+//				   (the meshes one after another). position0._parameter1 is the global source index as in every packed
+//				   layout and indexes _geometryIndexArray, so a hit maps back to (geometry, local primitive) without a search,
+//				   also after reorderPrimitives on _packedNodeArray.
+struct MultiMeshKdTree
+{
+	std::vector<PackedKdNode> _packedNodeArray;
+	std::vector<uint32> _primitiveBaseArray;	// Note(jinpark) : first global primitive index per geometry
+	std::vector<uint32> _geometryIndexArray;	// Note(jinpark) : geometry index per global primitive index
+};
+
+// Note(jinpark) : linear motion between two keyframes, 4 per node. time 0 entries then time 1 entries.
+//				   internal (bbMin0, 0xffffffff), (bbMax0, next), (bbMin1, 0), (bbMax1, 0)
+//				   leaf (edge0 at 0, primitiveIndex), (edge1 at 0, next), (edge0 at 1, 0), (edge1 at 1, 0)
+//				   _positionArray has position0 at time 0 and at time 1 per primitive. bounds and edges are lerped by the ray time.
+struct MotionKdTree
+{
+	std::vector<PackedKdNode> _nodeArray;
+	std::vector<float3> _positionArray;
+};
+
+enum class KdShapeType : uint32
+{
+	Box,		// Note(jinpark) : user bounds only, the leaf box is the primitive and intersection is up to the caller
+	Sphere,
+	Capsule,
+};
+
+struct KdSphere
+{
+	float3 _center;
+	float _radius;
+};
+
+struct KdCapsule
+{
+	float3 _position0;
+	float3 _position1;
+	float _radius;
+};
+
+// Note(jinpark) : 32 bytes, sphere uses _position0 and _radius, capsule all of them, box none.
+struct KdShape
+{
+	float3 _position0;
+	float _radius;
+	float3 _position1;
+	uint32 _primitiveIndex;
+};
+
+// Note(jinpark) : tree over non-triangle primitives, 2 per node. internal (bbMin, 0xffffffff), (bbMax, next),
+//				   leaf (primitive bbMin, shapeIndex), (primitive bbMax, next). _shapeArray is in leaf order.
+struct ShapeKdTree
+{
+	KdShapeType _shapeType = KdShapeType::Box;
+	std::vector<PackedKdNode> _nodeArray;
+	std::vector<KdShape> _shapeArray;
+};
+
+// Note(jinpark) : scratch and output memory kept alive between builds. vectors only grow,
+//				   so once warmed up a build of the same or smaller size does not touch the heap.
+class KdTreeBuildContext
+{
+public:
+	void reserve(const uint32 primitiveCount);
+	void shrink();
+
+	const std::vector<PackedKdNode>& getPackedNodeArray() const { return _packedNodeArray; }
+
+private:
+	friend class KdTree;
+
+	KdPrimitiveArray _primitiveArray;
+	std::vector<PackedKdNode> _packedNodeArray;
+};
+
+class KdTreeCache;
+
 class KdTree
 {
 public:
 	void build(std::vector<PackedKdNode>& outPackedNodeArray, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
-	
+	// Note(jinpark) : outPackedNodes must have getPackedNodeCount(indexCount / 3) elements.
+	void build(PackedKdNode* outPackedNodes, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
+	// Note(jinpark) : result is context.getPackedNodeArray(), valid until the next build with the same context.
+	void build(KdTreeBuildContext& context, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
+
+	// Note(jinpark) : any index and vertex format of KdTreeMeshView, no converted copy of the mesh is made.
+	void build(std::vector<PackedKdNode>& outPackedNodeArray, const KdTreeMeshView& meshView);
+	void build(PackedKdNode* outPackedNodes, const KdTreeMeshView& meshView);
+	// Note(jinpark) : position0 table in leaf order, see reorderPrimitives.
+	void build(std::vector<PackedKdNode>& outPackedNodeArray, std::vector<uint32>& outPrimitiveRemap, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
+
+	// Note(jinpark) : index based leaves, the cache is not used for this layout.
+	void build(IndexedKdTree& outIndexedTree, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
+
+	// Note(jinpark) : internal node bounds in half precision, conservatively rounded. leaves stay full precision.
+	void build(HalfKdTree& outHalfTree, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
+
+	void build(LeafKdTree& outLeafTree, const KdTreeLeafEncoding leafEncoding, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
+
+	// Note(jinpark) : 64-bit primitive count, vertex indices stay uint32. every segment is built with the packed build,
+	//				   so an attached cache is used per segment.
+	void build(SegmentedKdTree& outSegmentedTree, const void* vertices, uint32 stride, const uint32* indices, const uint64 indexCount, const uint32 maxSegmentPrimitiveCount = kMaxSegmentPrimitiveCount);
+
+	// Note(jinpark) : geometry index is the index in meshViewArray, every view keeps its own pointers and formats.
+	//				   the cache is not used for this layout.
+	void build(MultiMeshKdTree& outMultiMeshTree, const std::vector<KdTreeMeshView>& meshViewArray);
+
+	// Note(jinpark) : meshView is the time 0 keyframe, vertices1 the time 1 keyframe in the same format and stride.
+	//				   the hierarchy is built once over the bounds of the whole motion and refit at both keyframes.
+	void build(MotionKdTree& outMotionTree, const KdTreeMeshView& meshView, const void* vertices1);
+
+	// Note(jinpark) : the same hierarchy over any bounds. getBound(outBBMin, outBBMax, primitiveIndex) is called once per primitive.
+	void build(ShapeKdTree& outShapeTree, const uint32 primitiveCount, const std::function<void(float3&, float3&, const uint32)>& getBound);
+	void build(ShapeKdTree& outShapeTree, const KdSphere* spheres, const uint32 sphereCount);
+	void build(ShapeKdTree& outShapeTree, const KdCapsule* capsules, const uint32 capsuleCount);
+
+	// Note(jinpark) : the tree is built over triangle pairs, the cache is not used for this layout.
+	void build(QuadKdTree& outQuadTree, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
+
+	// Note(jinpark) : not owned. with a cache attached, the PackedKdNode builds return the cached tree for a known mesh,
+	//				   and so does the packed build the Half, Leaf and Segmented (per segment) layouts are converted from.
+	//				   the other layouts are always rebuilt.
+	void setCache(KdTreeCache* cache) { _cache = cache; }
+
+	static uint32 getPackedNodeCount(const uint32 primitiveCount);
+	static uint32 getIndexedNodeCount(const uint32 primitiveCount);
+	static uint32 getLeafNodeCount(const uint32 primitiveCount);
+	static uint32 getQuadNodeCount(const uint32 quadCount);
+
+	static void buildPrimitiveArray(KdPrimitiveArray& outPrimitiveArray, const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount);
+	static void buildPrimitiveArray(KdPrimitiveArray& outPrimitiveArray, const KdTreeMeshView& meshView);
+	static void buildRangeNodeArray(std::vector<RangeKdNode>& outNodeArray, KdPrimitiveArray& primitiveArray, const uint32 maxLeafPrimitiveCount);
+	static uint32 splitPrimitiveArray(KdPrimitiveArray& primitiveArray, const uint32 beginIndex, const uint32 endIndex, const float3& bbMin, const float3& bbMax);
+	static void buildBoundBox(float3& out_bbMin, float3& out_bbMax, const KdPrimitiveArray& primitiveArray, uint32 beginIndex, uint32 endIndex);
+	static void buildHalfTree(HalfKdTree& outHalfTree, const PackedKdNode* packedNodes, const uint32 packedNodeCount);
+
+	// Note(jinpark) : permutes the position0 table into leaf (pre-order) order, so neighbouring leaves read neighbouring entries.
+	//				   hits then report the leaf order index, outPrimitiveRemap[it] is the source primitive index. it is read from
+	//				   position0._parameter1, which every build writes and the permutation carries along, so calling it again on
+	//				   a reordered tree is a no-op that returns the same remap.
+	static void reorderPrimitives(std::vector<uint32>& outPrimitiveRemap, PackedKdNode* packedNodes, const uint32 packedNodeCount);
+
 private:
-	uint32 buildInternal(std::vector<RawKdNodeData>& nodeArray, const uint32 beginIndex, const uint32 endIndex);
-	void buildBoundBox(float3& out_bbMin, float3& out_bbMax, const std::vector<RawKdNodeData>& nodeArray, uint32 beginIndex, uint32 endIndex);
-	void buildNodeOrder(std::vector<RawKdNodeData>& nodeArray, const uint32 rootNodeIndex);
+	void buildPackedNode(PackedKdNode* outPackedNodes, KdPrimitiveArray& primitiveArray, const KdTreeMeshView& meshView);
+	void buildInternal(PackedKdNode* outPackedNodes, KdPrimitiveArray& primitiveArray, const KdTreeMeshView& meshView, const float3& bbMin, const float3& bbMax);
+	void buildIndexedInternal(IndexedKdTree& outIndexedTree, KdPrimitiveArray& primitiveArray, const KdTreeMeshView& meshView, const float3& bbMin, const float3& bbMax);
+	void buildShapeInternal(ShapeKdTree& outShapeTree, const KdShapeType shapeType, const KdShape* shapes);
 	
 private:
-	std::vector<KdNode> _nodeArray;
-};
-
+	KdTreeBuildContext _buildContext;
+	KdTreeCache* _cache = nullptr;
+};
\ No newline at end of file
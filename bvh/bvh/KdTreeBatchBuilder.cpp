@@ -0,0 +1,138 @@
+#include "KdTreeBatchBuilder.h"
+#include <algorithm>
+
+KdTreeBatchBuilder::KdTreeBatchBuilder(uint32 threadCount)
+{
+	if (0 == threadCount)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (uint32 threadIndex = 1; threadIndex < threadCount; ++threadIndex)
+	{
+		_workerArray.emplace_back(&KdTreeBatchBuilder::runWorker, this);
+	}
+}
+
+KdTreeBatchBuilder::~KdTreeBatchBuilder()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_isStopping = true;
+	}
+	_startCondition.notify_all();
+
+	for (std::thread& worker : _workerArray)
+	{
+		worker.join();
+	}
+}
+
+// Note(jinpark) : the KdTree of a worker lives as long as the worker, its build scratch is reused by every batch.
+void KdTreeBatchBuilder::runWorker()
+{
+	KdTree kdTree;
+	uint32 generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_startCondition.wait(lock, [this, generation]() { return (true == _isStopping) || (generation != _generation); });
+			if (true == _isStopping)
+			{
+				return;
+			}
+			generation = _generation;
+		}
+
+		buildMeshes(kdTree);
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			--_runningWorkerCount;
+		}
+		_finishCondition.notify_one();
+	}
+}
+
+// Note(jinpark) : workers pull the next mesh from a shared cursor.
+void KdTreeBatchBuilder::buildMeshes(KdTree& kdTree)
+{
+	const uint32 meshCount = static_cast<uint32>(_buildOrderArray.size());
+	for (uint32 i = _buildCursor.fetch_add(1); i < meshCount; i = _buildCursor.fetch_add(1))
+	{
+		const uint32 meshIndex = _buildOrderArray[i];
+		const KdTreeMeshView& meshView = (*_meshViewArray)[meshIndex];
+
+		PackedKdNode* outPackedNodes = _batch->_packedNodeArray.data() + _batch->_offsetArray[meshIndex];
+		kdTree.build(outPackedNodes, meshView);
+	}
+}
+
+bool KdTreeBatchBuilder::build(KdTreeBatch& outBatch, const std::vector<KdTreeMeshView>& meshViewArray)
+{
+	const uint32 meshCount = static_cast<uint32>(meshViewArray.size());
+
+	// Note(jinpark) : 1 step - packed size is known from the primitive count, so the arena is allocated once.
+	outBatch._offsetArray.resize(meshCount);
+	outBatch._countArray.resize(meshCount);
+
+	uint64 totalPackedNodeCount = 0;
+	for (uint32 meshIndex = 0; meshIndex < meshCount; ++meshIndex)
+	{
+		const KdTreeMeshView& meshView = meshViewArray[meshIndex];
+		assert(0 == (meshView._indexCount % 3));
+
+		const uint32 packedNodeCount = KdTree::getPackedNodeCount(meshView._indexCount / 3);
+		outBatch._offsetArray[meshIndex] = totalPackedNodeCount;
+		outBatch._countArray[meshIndex] = packedNodeCount;
+		totalPackedNodeCount += packedNodeCount;
+	}
+
+	// Note(jinpark) : a 32 bit build can not address the arena of a very large batch.
+	if (outBatch._packedNodeArray.max_size() < totalPackedNodeCount)
+	{
+		outBatch._packedNodeArray.clear();
+		outBatch._offsetArray.clear();
+		outBatch._countArray.clear();
+		return false;
+	}
+
+	outBatch._packedNodeArray.resize(static_cast<size_t>(totalPackedNodeCount));
+
+	// Note(jinpark) : 2 step - biggest mesh first, so the last mesh picked up by a worker is a small one.
+	_buildOrderArray.resize(meshCount);
+	for (uint32 meshIndex = 0; meshIndex < meshCount; ++meshIndex)
+	{
+		_buildOrderArray[meshIndex] = meshIndex;
+	}
+
+	std::sort(_buildOrderArray.begin(), _buildOrderArray.end(),
+		[&meshViewArray](uint32 lhs, uint32 rhs)
+		{
+			return meshViewArray[lhs]._indexCount > meshViewArray[rhs]._indexCount;
+		});
+
+	// Note(jinpark) : 3 step - wake the workers, build on this thread too and wait for the rest.
+	_batch = &outBatch;
+	_meshViewArray = &meshViewArray;
+	_buildCursor.store(0);
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_runningWorkerCount = static_cast<uint32>(_workerArray.size());
+		++_generation;
+	}
+	_startCondition.notify_all();
+
+	buildMeshes(_kdTree);
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_finishCondition.wait(lock, [this]() { return 0 == _runningWorkerCount; });
+	}
+
+	_batch = nullptr;
+	_meshViewArray = nullptr;
+	return true;
+}
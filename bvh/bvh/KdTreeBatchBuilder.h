@@ -0,0 +1,61 @@
+#pragma once
+
+#include "KdTree.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Note(jinpark) : every packed tree of the batch lives in one arena, mesh i is
+//				   [_offsetArray[i], _offsetArray[i] + _countArray[i]) of _packedNodeArray.
+//				   offsets are 64 bit, a batch of many meshes passes 4G nodes long before one mesh does.
+struct KdTreeBatch
+{
+	std::vector<PackedKdNode> _packedNodeArray;
+	std::vector<uint64> _offsetArray;
+	std::vector<uint32> _countArray;
+
+	const PackedKdNode* getPackedNodes(uint32 meshIndex) const { return _packedNodeArray.data() + _offsetArray[meshIndex]; }
+	uint32 getPackedNodeCount(uint32 meshIndex) const { return _countArray[meshIndex]; }
+};
+
+// Note(jinpark) : owns its workers, they are started once and wait between builds.
+//				   the thread calling build() works on the batch too, so threadCount - 1 workers are started.
+//				   build() is not reentrant, one batch at a time per builder.
+class KdTreeBatchBuilder
+{
+public:
+	// Note(jinpark) : threadCount 0 uses std::thread::hardware_concurrency.
+	explicit KdTreeBatchBuilder(uint32 threadCount = 0);
+	~KdTreeBatchBuilder();
+
+	DISALLOW_ASSIGN_COPY(KdTreeBatchBuilder);
+
+public:
+	// Note(jinpark) : false when the arena does not fit in memory addressable here, outBatch is then empty.
+	bool build(KdTreeBatch& outBatch, const std::vector<KdTreeMeshView>& meshViewArray);
+
+	uint32 getThreadCount() const { return static_cast<uint32>(_workerArray.size()) + 1; }
+
+private:
+	void runWorker();
+	void buildMeshes(KdTree& kdTree);
+
+private:
+	std::vector<std::thread> _workerArray;
+	KdTree _kdTree;					// Note(jinpark) : used by the thread calling build()
+
+	std::mutex _mutex;
+	std::condition_variable _startCondition;
+	std::condition_variable _finishCondition;
+	uint32 _generation = 0;			// Note(jinpark) : bumped per build, a worker runs once per generation
+	uint32 _runningWorkerCount = 0;
+	bool _isStopping = false;
+
+	// Note(jinpark) : the current build, valid while _runningWorkerCount is not 0.
+	KdTreeBatch* _batch = nullptr;
+	const std::vector<KdTreeMeshView>* _meshViewArray = nullptr;
+	std::vector<uint32> _buildOrderArray;
+	std::atomic<uint32> _buildCursor{ 0 };
+};
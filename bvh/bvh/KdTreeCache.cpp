@@ -0,0 +1,159 @@
+#include "KdTreeCache.h"
+#include "KdTreeFile.h"
+#include "StreamHash.h"
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+KdTreeCache::KdTreeCache(const KdTreeCacheSettings& settings)
+	: _settings(settings)
+{
+}
+
+KdTreeCacheKey KdTreeCache::computeKey(const KdTreeMeshView& meshView)
+{
+	KdTreeCacheKey key;
+	key._primitiveCount = meshView._indexCount / 3;
+
+	if (0 == meshView._indexCount)
+	{
+		return key;
+	}
+
+	// Note(jinpark) : vertex count is not part of the view, the referenced range ends at the largest index.
+	uint32 maxIndex = 0;
+	for (uint32 cornerIndex = 0; cornerIndex < meshView._indexCount; ++cornerIndex)
+	{
+		maxIndex = std::max(maxIndex, meshView.getVertexIndex(cornerIndex));
+	}
+	const size_t vertexByteCount = static_cast<size_t>(maxIndex) * meshView._stride + meshView.getVertexByteCount();
+
+	StreamHash hash;
+	hash.UpdateValue(KdTreeFile::getDefaultBuildConfigHash());
+	hash.UpdateValue(meshView._stride);
+	hash.UpdateValue(meshView._indexCount);
+	hash.UpdateValue(meshView._indexFormat);
+	hash.UpdateValue(meshView._vertexFormat);
+	if ((KdTreeVertexFormat::Snorm16x3 == meshView._vertexFormat) || (KdTreeVertexFormat::Unorm16x3 == meshView._vertexFormat))
+	{
+		hash.UpdateValue(meshView._positionScale);
+		hash.UpdateValue(meshView._positionOffset);
+	}
+	if (KdTreeIndexFormat::None != meshView._indexFormat)
+	{
+		hash.Update(meshView._indices, meshView._indexCount * meshView.getIndexByteCount());
+	}
+	hash.Update(meshView._vertices, vertexByteCount);
+
+	key._hash = hash.GetResult();
+	return key;
+}
+
+bool KdTreeCache::find(PackedKdNode* outPackedNodes, const KdTreeCacheKey& key)
+{
+	const uint32 packedNodeCount = KdTree::getPackedNodeCount(key._primitiveCount);
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto found = _entryMap.find(key);
+		if (_entryMap.end() != found)
+		{
+			_entryList.splice(_entryList.begin(), _entryList, found->second);
+			memcpy(outPackedNodes, found->second->_packedNodeArray.data(), packedNodeCount * sizeof(PackedKdNode));
+
+			_memoryHitCount.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	if (false == _settings._directoryPath.empty())
+	{
+		KdTreeFile file;
+		if ((true == file.open(getFilePath(key))) && (packedNodeCount == file.getPackedNodeCount()))
+		{
+			memcpy(outPackedNodes, file.getPackedNodes(), packedNodeCount * sizeof(PackedKdNode));
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			insertMemory(key, outPackedNodes);
+
+			_diskHitCount.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	_missCount.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void KdTreeCache::insert(const KdTreeCacheKey& key, const PackedKdNode* packedNodes)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		insertMemory(key, packedNodes);
+	}
+
+	if (false == _settings._directoryPath.empty())
+	{
+		// Note(jinpark) : write aside and rename, a reader never maps a half written file.
+		const std::string filePath = getFilePath(key);
+		const std::string tempFilePath = filePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+		if (true == KdTreeFile::save(tempFilePath, packedNodes, KdTree::getPackedNodeCount(key._primitiveCount)))
+		{
+			if (0 != rename(tempFilePath.c_str(), filePath.c_str()))
+			{
+				// Note(jinpark) : another writer got there first, the content is the same.
+				remove(tempFilePath.c_str());
+			}
+		}
+	}
+}
+
+void KdTreeCache::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_entryMap.clear();
+	_entryList.clear();
+	_memoryByteCount = 0;
+}
+
+std::string KdTreeCache::getFilePath(const KdTreeCacheKey& key) const
+{
+	char fileName[64];
+	snprintf(fileName, sizeof(fileName), "%016llx_%u.kdt", key._hash, key._primitiveCount);
+
+	return _settings._directoryPath + "/" + fileName;
+}
+
+void KdTreeCache::insertMemory(const KdTreeCacheKey& key, const PackedKdNode* packedNodes)
+{
+	const uint32 packedNodeCount = KdTree::getPackedNodeCount(key._primitiveCount);
+	const size_t byteCount = packedNodeCount * sizeof(PackedKdNode);
+
+	if ((_settings._memoryBudgetByteCount < byteCount) || (_entryMap.end() != _entryMap.find(key)))
+	{
+		return;
+	}
+
+	while (_settings._memoryBudgetByteCount < _memoryByteCount + byteCount)
+	{
+		Entry& lastEntry = _entryList.back();
+		_memoryByteCount -= lastEntry._packedNodeArray.size() * sizeof(PackedKdNode);
+
+		_entryMap.erase(lastEntry._key);
+		_entryList.pop_back();
+	}
+
+	_entryList.emplace_front();
+
+	Entry& entry = _entryList.front();
+	entry._key = key;
+	entry._packedNodeArray.assign(packedNodes, packedNodes + packedNodeCount);
+
+	_entryMap[key] = _entryList.begin();
+	_memoryByteCount += byteCount;
+}
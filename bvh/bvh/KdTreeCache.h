@@ -0,0 +1,77 @@
+#pragma once
+
+#include "KdTree.h"
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct KdTreeCacheKey
+{
+	uint64 _hash = 0;
+	uint32 _primitiveCount = 0;
+
+	bool operator==(const KdTreeCacheKey& rhs) const { return (_hash == rhs._hash) && (_primitiveCount == rhs._primitiveCount); }
+};
+
+struct KdTreeCacheSettings
+{
+	// Note(jinpark) : empty path disables the disk tier.
+	std::string _directoryPath;
+	size_t _memoryBudgetByteCount = 256 << 20;
+};
+
+// Note(jinpark) : packed trees keyed by mesh content and build configuration.
+//				   memory tier is LRU within the byte budget, disk tier is one KdTreeFile per key and is never evicted here.
+//				   attach to KdTree with setCache(), every build overload then checks the cache first.
+class KdTreeCache
+{
+public:
+	explicit KdTreeCache(const KdTreeCacheSettings& settings = KdTreeCacheSettings());
+
+	DISALLOW_ASSIGN_COPY(KdTreeCache);
+
+public:
+	static KdTreeCacheKey computeKey(const KdTreeMeshView& meshView);
+
+	// Note(jinpark) : outPackedNodes must have KdTree::getPackedNodeCount(key._primitiveCount) elements.
+	bool find(PackedKdNode* outPackedNodes, const KdTreeCacheKey& key);
+	void insert(const KdTreeCacheKey& key, const PackedKdNode* packedNodes);
+
+	// Note(jinpark) : drops the memory tier only.
+	void clear();
+
+	uint32 getMemoryHitCount() const { return _memoryHitCount.load(std::memory_order_relaxed); }
+	uint32 getDiskHitCount() const { return _diskHitCount.load(std::memory_order_relaxed); }
+	uint32 getMissCount() const { return _missCount.load(std::memory_order_relaxed); }
+
+private:
+	struct Entry
+	{
+		KdTreeCacheKey _key;
+		std::vector<PackedKdNode> _packedNodeArray;
+	};
+
+	struct KeyHasher
+	{
+		size_t operator()(const KdTreeCacheKey& key) const { return static_cast<size_t>(key._hash); }
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	std::string getFilePath(const KdTreeCacheKey& key) const;
+	void insertMemory(const KdTreeCacheKey& key, const PackedKdNode* packedNodes);
+
+private:
+	KdTreeCacheSettings _settings;
+
+	std::mutex _mutex;
+	EntryList _entryList;	// Note(jinpark) : front is the most recently used.
+	std::unordered_map<KdTreeCacheKey, EntryList::iterator, KeyHasher> _entryMap;
+	size_t _memoryByteCount = 0;
+
+	std::atomic<uint32> _memoryHitCount{ 0 };
+	std::atomic<uint32> _diskHitCount{ 0 };
+	std::atomic<uint32> _missCount{ 0 };
+};
@@ -0,0 +1,292 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "KdTreeFile.h"
+#include "KdTreeTraversal.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Note(jinpark) : bump whenever the packed layout written by KdTree::build changes.
+const uint32 kKdTreeLayoutRevision = 2;
+
+KdTreeFile::~KdTreeFile()
+{
+	close();
+}
+
+bool KdTreeFile::save(const std::string& filePath, const std::vector<PackedKdNode>& packedNodeArray, const uint32 buildConfigHash)
+{
+	return save(filePath, packedNodeArray.data(), static_cast<uint32>(packedNodeArray.size()), buildConfigHash);
+}
+
+bool KdTreeFile::save(const std::string& filePath, const PackedKdNode* packedNodes, const uint32 packedNodeCount, const uint32 buildConfigHash)
+{
+	float3 bbMin, bbMax;
+	buildBoundBox(bbMin, bbMax, packedNodes, packedNodeCount);
+
+	KdTreeFileHeader header;
+	buildHeader(header, packedNodeCount, bbMin, bbMax, buildConfigHash);
+
+	FILE* file = fopen(filePath.c_str(), "wb");
+	if (nullptr == file)
+	{
+		return false;
+	}
+
+	bool isSucceeded = (1 == fwrite(&header, sizeof(KdTreeFileHeader), 1, file));
+	if ((true == isSucceeded) && (0 < packedNodeCount))
+	{
+		isSucceeded = (packedNodeCount == fwrite(packedNodes, sizeof(PackedKdNode), packedNodeCount, file));
+	}
+
+	isSucceeded = (0 == fclose(file)) && isSucceeded;
+	if (false == isSucceeded)
+	{
+		remove(filePath.c_str());
+	}
+
+	return isSucceeded;
+}
+
+bool KdTreeFile::open(const std::string& filePath, const uint32 buildConfigHash)
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (INVALID_HANDLE_VALUE == fileHandle)
+	{
+		return false;
+	}
+	_fileHandle = fileHandle;
+
+	LARGE_INTEGER fileSize;
+	if ((FALSE == GetFileSizeEx(fileHandle, &fileSize)) || (fileSize.QuadPart < static_cast<LONGLONG>(sizeof(KdTreeFileHeader))))
+	{
+		close();
+		return false;
+	}
+
+	_mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (nullptr == _mappingHandle)
+	{
+		close();
+		return false;
+	}
+
+	_mappedData = MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	_mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const int fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if ((0 != fstat(fileDescriptor, &fileStat)) || (fileStat.st_size < static_cast<off_t>(sizeof(KdTreeFileHeader))))
+	{
+		::close(fileDescriptor);
+		return false;
+	}
+
+	// Note(jinpark) : the mapping keeps the file alive, the descriptor is not needed after mmap.
+	void* mappedData = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	::close(fileDescriptor);
+
+	_mappedData = (MAP_FAILED == mappedData) ? nullptr : mappedData;
+	_mappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	if (nullptr == _mappedData)
+	{
+		close();
+		return false;
+	}
+
+	const KdTreeFileHeader& header = getHeader();
+	const bool isValidHeader = (kKdTreeFileMagic == header._magic)
+		&& (kKdTreeFileVersion == header._version)
+		&& (sizeof(KdTreeFileHeader) == header._headerSize)
+		&& (buildConfigHash == header._buildConfigHash)
+		&& (0 == (header._packedNodeOffset % kKdTreeFileAlignment))
+		&& (header._packedNodeOffset >= header._headerSize)
+		&& (static_cast<size_t>(header._packedNodeOffset) + static_cast<size_t>(header._packedNodeCount) * sizeof(PackedKdNode) <= _mappedSize);
+
+	const bool isValidLayout = (true == isSegmented()) ? validateSegments() : (KdTree::getPackedNodeCount(header._primitiveCount) == header._packedNodeCount);
+	if ((false == isValidHeader) || (false == isValidLayout))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void KdTreeFile::close()
+{
+#if defined(_WIN32)
+	if (nullptr != _mappedData)
+	{
+		UnmapViewOfFile(_mappedData);
+	}
+	if (nullptr != _mappingHandle)
+	{
+		CloseHandle(_mappingHandle);
+	}
+	if (nullptr != _fileHandle)
+	{
+		CloseHandle(_fileHandle);
+	}
+#else
+	if (nullptr != _mappedData)
+	{
+		munmap(const_cast<void*>(_mappedData), _mappedSize);
+	}
+#endif
+
+	_mappedData = nullptr;
+	_mappedSize = 0;
+	_fileHandle = nullptr;
+	_mappingHandle = nullptr;
+}
+
+const PackedKdNode* KdTreeFile::getPackedNodes() const
+{
+	return reinterpret_cast<const PackedKdNode*>(static_cast<const uint8_t*>(_mappedData) + getHeader()._packedNodeOffset);
+}
+
+const KdTreeFileSegment* KdTreeFile::getSegments() const
+{
+	// Note(jinpark) : the segment table follows the top tree.
+	return reinterpret_cast<const KdTreeFileSegment*>(getPackedNodes() + getHeader()._packedNodeCount);
+}
+
+const PackedKdNode* KdTreeFile::getSegmentPackedNodes(const uint32 segmentIndex) const
+{
+	return reinterpret_cast<const PackedKdNode*>(static_cast<const uint8_t*>(_mappedData) + static_cast<size_t>(getSegments()[segmentIndex]._packedNodeOffset));
+}
+
+const uint64* KdTreeFile::getPrimitiveIndices() const
+{
+	return reinterpret_cast<const uint64*>(static_cast<const uint8_t*>(_mappedData) + static_cast<size_t>(getHeader()._primitiveIndexOffset));
+}
+
+bool KdTreeFile::validateSegments() const
+{
+	const KdTreeFileHeader& header = getHeader();
+	const uint64 segmentCount = header._primitiveCount;
+
+	// Note(jinpark) : the top tree has one leaf per segment.
+	if ((0 == segmentCount) || ((segmentCount * 2 - 1) * 2 != header._packedNodeCount))
+	{
+		return false;
+	}
+
+	const uint64 segmentTableOffset = header._packedNodeOffset + static_cast<uint64>(header._packedNodeCount) * sizeof(PackedKdNode);
+	const uint64 segmentTableEndOffset = segmentTableOffset + segmentCount * sizeof(KdTreeFileSegment);
+	if (_mappedSize < segmentTableEndOffset)
+	{
+		return false;
+	}
+
+	const KdTreeFileSegment* segments = getSegments();
+
+	uint64 primitiveCount = 0;
+	for (uint32 segmentIndex = 0; segmentIndex < segmentCount; ++segmentIndex)
+	{
+		const KdTreeFileSegment& segment = segments[segmentIndex];
+		const bool isValidSegment = (0 == (segment._packedNodeOffset % kKdTreeFileAlignment))
+			&& (segment._packedNodeOffset >= segmentTableEndOffset)
+			&& (0 < segment._primitiveCount) && (segment._primitiveCount <= kMaxSegmentPrimitiveCount)
+			&& (KdTree::getPackedNodeCount(segment._primitiveCount) == segment._packedNodeCount)
+			&& (segment._packedNodeOffset <= _mappedSize)
+			&& (segment._packedNodeCount <= (_mappedSize - segment._packedNodeOffset) / sizeof(PackedKdNode))
+			&& (segment._primitiveBase == primitiveCount);
+
+		if (false == isValidSegment)
+		{
+			return false;
+		}
+
+		primitiveCount += segment._primitiveCount;
+	}
+
+	return (0 == (header._primitiveIndexOffset % sizeof(uint64)))
+		&& (header._primitiveIndexOffset <= _mappedSize)
+		&& (primitiveCount <= (_mappedSize - header._primitiveIndexOffset) / sizeof(uint64));
+}
+
+void KdTreeFile::buildHeader(KdTreeFileHeader& outHeader, const uint32 packedNodeCount, const float3& bbMin, const float3& bbMax, const uint32 buildConfigHash)
+{
+	outHeader = KdTreeFileHeader();
+
+	outHeader._magic = kKdTreeFileMagic;
+	outHeader._version = kKdTreeFileVersion;
+	outHeader._headerSize = sizeof(KdTreeFileHeader);
+	outHeader._buildConfigHash = buildConfigHash;
+
+	outHeader._packedNodeCount = packedNodeCount;
+	outHeader._primitiveCount = KdTreeTraversal::getPrimitiveCount(packedNodeCount);
+	outHeader._packedNodeOffset = sizeof(KdTreeFileHeader);
+	outHeader._flags = 0;
+
+	outHeader._bbMin = bbMin;
+	outHeader._bbMax = bbMax;
+}
+
+void KdTreeFile::buildBoundBox(float3& out_bbMin, float3& out_bbMax, const PackedKdNode* packedNodes, const uint32 packedNodeCount)
+{
+	out_bbMin = float3(0.0f, 0.0f, 0.0f);
+	out_bbMax = float3(0.0f, 0.0f, 0.0f);
+
+	if (0 == packedNodeCount)
+	{
+		return;
+	}
+
+	const bool isLeafRoot = (0xffffffff != packedNodes[0]._parameter1);
+	if (false == isLeafRoot)
+	{
+		out_bbMin = packedNodes[0]._parameter0;
+		out_bbMax = packedNodes[1]._parameter0;
+		return;
+	}
+
+	// Note(jinpark) : single primitive tree, root is the leaf itself.
+	const float3& position0 = packedNodes[packedNodes[0]._parameter1]._parameter0;
+	const float3 position1 = position0 + packedNodes[0]._parameter0;
+	const float3 position2 = position0 + packedNodes[1]._parameter0;
+
+	out_bbMin = float3::Min(float3::Min(position0, position1), position2);
+	out_bbMax = float3::Max(float3::Max(position0, position1), position2);
+}
+
+uint32 KdTreeFile::computeHash(const void* data, const size_t size, const uint32 hash)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	uint32 result = hash;
+	for (size_t i = 0; i < size; ++i)
+	{
+		result ^= bytes[i];
+		result *= 16777619u;
+	}
+	return result;
+}
+
+uint32 KdTreeFile::getDefaultBuildConfigHash()
+{
+	const uint32 config[] = { kKdTreeLayoutRevision, static_cast<uint32>(sizeof(PackedKdNode)), 1 /* Note(jinpark) : max leaf primitive count */ };
+	return computeHash(config, sizeof(config));
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "KdTree.h"
+#include <string>
+
+const uint32 kKdTreeFileMagic = 0x3054444b;	// Note(jinpark) : "KDT0"
+const uint32 kKdTreeFileVersion = 1;
+const uint32 kKdTreeFileAlignment = 64;
+
+// Note(jinpark) : the position0 table is not in source order, position0._parameter1 maps it back (KdTreeStreamBuilder output).
+const uint32 kKdTreeFileFlagSourcePrimitiveIndex = 1 << 0;
+
+// Note(jinpark) : KdTreeStreamBuilder output over more primitives than a packed buffer can index, SegmentedKdTree on disk.
+//				   the packed nodes are the top tree, _primitiveCount is the segment count and the KdTreeFileSegment table
+//				   follows the top tree. the uint64 source index table is at _primitiveIndexOffset.
+const uint32 kKdTreeFileFlagSegmented = 1 << 1;
+
+// Note(jinpark) : 64 bytes, packed nodes start at _packedNodeOffset which is aligned to kKdTreeFileAlignment.
+struct KdTreeFileHeader
+{
+	uint32 _magic;
+	uint32 _version;
+	uint32 _headerSize;
+	uint32 _buildConfigHash;
+
+	uint32 _packedNodeCount;
+	uint32 _primitiveCount;
+	uint32 _packedNodeOffset;
+	uint32 _flags;
+
+	float3 _bbMin;
+	float3 _bbMax;
+
+	uint64 _primitiveIndexOffset;	// Note(jinpark) : kKdTreeFileFlagSegmented only, 0 otherwise
+};
+static_assert(sizeof(KdTreeFileHeader) == kKdTreeFileAlignment, "KdTreeFileHeader must fill one alignment unit");
+
+// Note(jinpark) : 32 bytes, a usual packed tree at _packedNodeOffset (aligned to kKdTreeFileAlignment).
+//				   position0._parameter1 is the index in the segment, source index table[_primitiveBase + it] the source index.
+struct KdTreeFileSegment
+{
+	uint64 _packedNodeOffset;
+	uint64 _primitiveBase;
+	uint32 _packedNodeCount;
+	uint32 _primitiveCount;
+	uint32 _reserved[2];
+};
+static_assert(sizeof(KdTreeFileSegment) == 32, "KdTreeFileSegment must be 32 bytes");
+
+// Note(jinpark) : read only view of a saved tree. the file is mapped, not read,
+//				   getPackedNodes() points into the mapping and is traversed in place.
+class KdTreeFile
+{
+public:
+	KdTreeFile() = default;
+	~KdTreeFile();
+
+	DISALLOW_ASSIGN_COPY(KdTreeFile);
+
+public:
+	static bool save(const std::string& filePath, const std::vector<PackedKdNode>& packedNodeArray, const uint32 buildConfigHash = getDefaultBuildConfigHash());
+	static bool save(const std::string& filePath, const PackedKdNode* packedNodes, const uint32 packedNodeCount, const uint32 buildConfigHash = getDefaultBuildConfigHash());
+
+	// Note(jinpark) : fails if the file is truncated, from another version or built with another configuration.
+	//				   a segmented file needs a 64-bit process, it is mapped whole.
+	bool open(const std::string& filePath, const uint32 buildConfigHash = getDefaultBuildConfigHash());
+	void close();
+
+	bool isOpen() const { return nullptr != _mappedData; }
+
+	const KdTreeFileHeader& getHeader() const { return *static_cast<const KdTreeFileHeader*>(_mappedData); }
+	const PackedKdNode* getPackedNodes() const;
+	uint32 getPackedNodeCount() const { return getHeader()._packedNodeCount; }
+
+	// Note(jinpark) : kKdTreeFileFlagSegmented files, getPackedNodes() is then the top tree.
+	bool isSegmented() const { return 0 != (getHeader()._flags & kKdTreeFileFlagSegmented); }
+	uint32 getSegmentCount() const { return isSegmented() ? getHeader()._primitiveCount : 0; }
+	const KdTreeFileSegment* getSegments() const;
+	const PackedKdNode* getSegmentPackedNodes(const uint32 segmentIndex) const;
+	const uint64* getPrimitiveIndices() const;
+
+	static void buildHeader(KdTreeFileHeader& outHeader, const uint32 packedNodeCount, const float3& bbMin, const float3& bbMax, const uint32 buildConfigHash);
+	static void buildBoundBox(float3& out_bbMin, float3& out_bbMax, const PackedKdNode* packedNodes, const uint32 packedNodeCount);
+
+	// Note(jinpark) : FNV-1a. pass the previous result as hash to chain several blocks.
+	static uint32 computeHash(const void* data, const size_t size, const uint32 hash = 2166136261u);
+	static uint32 getDefaultBuildConfigHash();
+
+private:
+	bool validateSegments() const;
+
+private:
+	const void* _mappedData = nullptr;
+	size_t _mappedSize = 0;
+
+	void* _fileHandle = nullptr;
+	void* _mappingHandle = nullptr;
+};
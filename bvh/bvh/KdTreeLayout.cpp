@@ -0,0 +1,349 @@
+#include "KdTreeLayout.h"
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+
+// Note(jinpark) : children of the packed (pre-order) tree. left child is the next node, right child is where the left subtree ends.
+struct LayoutTopology
+{
+	uint32 _kdNodeCount = 0;
+	std::vector<uint32> _rightArray;	// Note(jinpark) : 0xffffffff for leaf nodes
+	std::vector<uint32> _endArray;		// Note(jinpark) : subtree of i is [i, _endArray[i]) in pre-order
+	std::vector<float> _areaArray;
+
+	bool isLeaf(const uint32 nodeIndex) const { return 0xffffffff == _rightArray[nodeIndex]; }
+};
+
+static float computeSurfaceArea(const float3& bbMin, const float3& bbMax)
+{
+	const float3 extents = (bbMax - bbMin);
+	return (extents.x * extents.y + extents.y * extents.z + extents.x * extents.z) * 2.0f;
+}
+
+static void buildTopology(LayoutTopology& outTopology, const PackedKdNode* packedNodes, const uint32 packedNodeCount)
+{
+	const uint32 primitiveCount = (packedNodeCount + 2) / 5;
+	const uint32 kdNodeCount = primitiveCount * 2 - 1;
+
+	outTopology._kdNodeCount = kdNodeCount;
+	outTopology._rightArray.assign(kdNodeCount, 0xffffffff);
+	outTopology._endArray.resize(kdNodeCount);
+	outTopology._areaArray.resize(kdNodeCount);
+
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const PackedKdNode& packedNode0 = packedNodes[nodeIndex * 2 + 0];
+		const PackedKdNode& packedNode1 = packedNodes[nodeIndex * 2 + 1];
+
+		outTopology._endArray[nodeIndex] = (0xffffffff == packedNode1._parameter1) ? kdNodeCount : packedNode1._parameter1;
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+		if (true == isLeafNode)
+		{
+			const float3& position0 = packedNodes[packedNode0._parameter1]._parameter0;
+			const float3 positions[] = { position0, position0 + packedNode0._parameter0, position0 + packedNode1._parameter0 };
+
+			float3 bbMin = positions[0], bbMax = positions[0];
+			for (uint32 cornerIndex = 1; cornerIndex < 3; ++cornerIndex)
+			{
+				bbMin = float3(std::min(bbMin.x, positions[cornerIndex].x), std::min(bbMin.y, positions[cornerIndex].y), std::min(bbMin.z, positions[cornerIndex].z));
+				bbMax = float3(std::max(bbMax.x, positions[cornerIndex].x), std::max(bbMax.y, positions[cornerIndex].y), std::max(bbMax.z, positions[cornerIndex].z));
+			}
+			outTopology._areaArray[nodeIndex] = computeSurfaceArea(bbMin, bbMax);
+		}
+		else
+		{
+			const uint32 leftSkipIndex = packedNodes[(nodeIndex + 1) * 2 + 1]._parameter1;
+			outTopology._rightArray[nodeIndex] = leftSkipIndex;
+			outTopology._areaArray[nodeIndex] = computeSurfaceArea(packedNode0._parameter0, packedNode1._parameter0);
+		}
+	}
+}
+
+static void appendSubtree(std::vector<uint32>& outSequence, const LayoutTopology& topology, const uint32 rootIndex)
+{
+	for (uint32 nodeIndex = rootIndex; nodeIndex < topology._endArray[rootIndex]; ++nodeIndex)
+	{
+		outSequence.push_back(nodeIndex);
+	}
+}
+
+static void appendBreadthFirst(std::vector<uint32>& outSequence, const LayoutTopology& topology, const uint32 levelCount)
+{
+	std::vector<uint32> levelArray(1, 0);
+	std::vector<uint32> nextLevelArray;
+
+	for (uint32 levelIndex = 0; (levelIndex < levelCount) && (false == levelArray.empty()); ++levelIndex)
+	{
+		nextLevelArray.clear();
+		for (const uint32 nodeIndex : levelArray)
+		{
+			outSequence.push_back(nodeIndex);
+			if (false == topology.isLeaf(nodeIndex))
+			{
+				nextLevelArray.push_back(nodeIndex + 1);
+				nextLevelArray.push_back(topology._rightArray[nodeIndex]);
+			}
+		}
+		levelArray.swap(nextLevelArray);
+	}
+
+	for (const uint32 rootIndex : levelArray)
+	{
+		appendSubtree(outSequence, topology, rootIndex);
+	}
+}
+
+// Note(jinpark) : nodes exactly depth levels below rootIndex, left to right.
+static void collectLevel(std::vector<uint32>& outNodeArray, const LayoutTopology& topology, const uint32 rootIndex, const uint32 depth)
+{
+	std::vector<std::pair<uint32, uint32>> stack(1, std::make_pair(rootIndex, 0u));
+	while (false == stack.empty())
+	{
+		const std::pair<uint32, uint32> entry = stack.back();
+		stack.pop_back();
+
+		if (depth == entry.second)
+		{
+			outNodeArray.push_back(entry.first);
+		}
+		else if (false == topology.isLeaf(entry.first))
+		{
+			stack.push_back(std::make_pair(topology._rightArray[entry.first], entry.second + 1));
+			stack.push_back(std::make_pair(entry.first + 1, entry.second + 1));
+		}
+	}
+}
+
+static void appendVanEmdeBoas(std::vector<uint32>& outSequence, const LayoutTopology& topology, const uint32 rootIndex, const uint32 levelCount)
+{
+	if (1 == levelCount)
+	{
+		outSequence.push_back(rootIndex);
+		return;
+	}
+
+	const uint32 bottomLevelCount = levelCount / 2;
+	const uint32 topLevelCount = levelCount - bottomLevelCount;
+
+	appendVanEmdeBoas(outSequence, topology, rootIndex, topLevelCount);
+
+	std::vector<uint32> bottomRootArray;
+	collectLevel(bottomRootArray, topology, rootIndex, topLevelCount);
+
+	for (const uint32 bottomRootIndex : bottomRootArray)
+	{
+		appendVanEmdeBoas(outSequence, topology, bottomRootIndex, bottomLevelCount);
+	}
+}
+
+const uint32 kLayoutPaddingNode = 0xffffffff;
+
+// Note(jinpark) : sequence slots of kLayoutPaddingNode are padding.
+static void appendTreelet(std::vector<uint32>& outSequence, const LayoutTopology& topology, const uint32 treeletNodeCount)
+{
+	std::vector<uint32> rootStack(1, 0);
+	std::vector<uint32> candidateArray;
+	std::vector<uint32> treeletArray;
+
+	while (false == rootStack.empty())
+	{
+		const uint32 rootIndex = rootStack.back();
+		rootStack.pop_back();
+
+		// Note(jinpark) : a subtree that fits in the rest of the block goes there whole, in pre-order.
+		const uint32 subtreeNodeCount = topology._endArray[rootIndex] - rootIndex;
+		const uint32 freeNodeCount = (treeletNodeCount - static_cast<uint32>(outSequence.size() % treeletNodeCount)) % treeletNodeCount;
+		if (subtreeNodeCount <= freeNodeCount)
+		{
+			appendSubtree(outSequence, topology, rootIndex);
+			continue;
+		}
+
+		outSequence.resize(outSequence.size() + freeNodeCount, kLayoutPaddingNode);
+
+		treeletArray.clear();
+		candidateArray.assign(1, rootIndex);
+		for (uint32 nodeCount = 0; (nodeCount < treeletNodeCount) && (false == candidateArray.empty()); ++nodeCount)
+		{
+			uint32 bestIndex = 0;
+			for (uint32 candidateIndex = 1; candidateIndex < candidateArray.size(); ++candidateIndex)
+			{
+				if (topology._areaArray[candidateArray[bestIndex]] < topology._areaArray[candidateArray[candidateIndex]])
+				{
+					bestIndex = candidateIndex;
+				}
+			}
+
+			const uint32 nodeIndex = candidateArray[bestIndex];
+			candidateArray[bestIndex] = candidateArray.back();
+			candidateArray.pop_back();
+
+			treeletArray.push_back(nodeIndex);
+			if (false == topology.isLeaf(nodeIndex))
+			{
+				candidateArray.push_back(nodeIndex + 1);
+				candidateArray.push_back(topology._rightArray[nodeIndex]);
+			}
+		}
+
+		// Note(jinpark) : pre-order inside the block, a child that is in the treelet is mostly in the parent's cache line.
+		std::sort(treeletArray.begin(), treeletArray.end());
+		outSequence.insert(outSequence.end(), treeletArray.begin(), treeletArray.end());
+
+		// Note(jinpark) : what did not fit roots the next treelets, the leftmost is laid out next.
+		std::sort(candidateArray.begin(), candidateArray.end(), std::greater<uint32>());
+		rootStack.insert(rootStack.end(), candidateArray.begin(), candidateArray.end());
+	}
+}
+
+void KdTreeLayout::buildNodeOrder(std::vector<uint32>& outNodeOrder, uint32& outNodeCount, const PackedKdNode* packedNodes, const uint32 packedNodeCount, const KdTreeLayoutSettings& settings)
+{
+	outNodeOrder.clear();
+	outNodeCount = 0;
+	if (0 == packedNodeCount)
+	{
+		return;
+	}
+
+	LayoutTopology topology;
+	buildTopology(topology, packedNodes, packedNodeCount);
+
+	const uint32 kdNodeCount = topology._kdNodeCount;
+
+	std::vector<uint32> sequence;
+	sequence.reserve(kdNodeCount);
+
+	switch (settings._order)
+	{
+	case KdTreeNodeOrder::DepthFirst:
+		appendSubtree(sequence, topology, 0);
+		break;
+
+	case KdTreeNodeOrder::BreadthFirst:
+		appendBreadthFirst(sequence, topology, settings._breadthFirstLevelCount);
+		break;
+
+	case KdTreeNodeOrder::VanEmdeBoas:
+	{
+		// Note(jinpark) : children are after their parent in pre-order, so heights fill in backwards.
+		std::vector<uint32> heightArray(kdNodeCount, 1);
+		for (uint32 nodeIndex = kdNodeCount; 0 < nodeIndex--;)
+		{
+			if (false == topology.isLeaf(nodeIndex))
+			{
+				heightArray[nodeIndex] = 1 + std::max(heightArray[nodeIndex + 1], heightArray[topology._rightArray[nodeIndex]]);
+			}
+		}
+		appendVanEmdeBoas(sequence, topology, 0, heightArray[0]);
+		break;
+	}
+
+	case KdTreeNodeOrder::Treelet:
+		appendTreelet(sequence, topology, std::max(1u, settings._treeletByteCount / static_cast<uint32>(sizeof(PackedKdNode) * 2)));
+		break;
+	}
+
+	outNodeCount = static_cast<uint32>(sequence.size());
+	outNodeOrder.resize(kdNodeCount);
+	for (uint32 orderIndex = 0; orderIndex < outNodeCount; ++orderIndex)
+	{
+		if (kLayoutPaddingNode != sequence[orderIndex])
+		{
+			outNodeOrder[sequence[orderIndex]] = orderIndex;
+		}
+	}
+}
+
+void KdTreeLayout::build(OrderedKdTree& outOrderedTree, const PackedKdNode* packedNodes, const uint32 packedNodeCount, const KdTreeLayoutSettings& settings)
+{
+	outOrderedTree._order = settings._order;
+	outOrderedTree._nodeCount = 0;
+	outOrderedTree._nodeArray.clear();
+	if (0 == packedNodeCount)
+	{
+		return;
+	}
+
+	std::vector<uint32> nodeOrder;
+	uint32 orderedNodeCount = 0;
+	buildNodeOrder(nodeOrder, orderedNodeCount, packedNodes, packedNodeCount, settings);
+
+	const uint32 kdNodeCount = static_cast<uint32>(nodeOrder.size());
+	const uint32 primitiveOffset = kdNodeCount * 2;
+	const uint32 orderedPrimitiveOffset = orderedNodeCount * 2;
+
+	outOrderedTree._nodeCount = orderedNodeCount;
+	outOrderedTree._nodeArray.resize(orderedPrimitiveOffset + (packedNodeCount - primitiveOffset));
+
+	// Note(jinpark) : position0 table keeps its primitive order.
+	std::copy(packedNodes + primitiveOffset, packedNodes + packedNodeCount, outOrderedTree._nodeArray.begin() + orderedPrimitiveOffset);
+
+	for (uint32 nodeIndex = 0; nodeIndex < kdNodeCount; ++nodeIndex)
+	{
+		const PackedKdNode& packedNode0 = packedNodes[nodeIndex * 2 + 0];
+		const PackedKdNode& packedNode1 = packedNodes[nodeIndex * 2 + 1];
+
+		PackedKdNode* outNodes = outOrderedTree._nodeArray.data() + nodeOrder[nodeIndex] * 2;
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+
+		outNodes[0]._parameter0 = packedNode0._parameter0;
+		outNodes[0]._parameter1 = (true == isLeafNode) ? (packedNode0._parameter1 - primitiveOffset) : (kOrderedKdInternalFlag | nodeOrder[nodeIndex + 1]);
+		outNodes[1]._parameter0 = packedNode1._parameter0;
+		outNodes[1]._parameter1 = (0xffffffff == packedNode1._parameter1) ? 0xffffffff : nodeOrder[packedNode1._parameter1];
+	}
+}
+
+KdTreeCacheModel::KdTreeCacheModel(const uint32 byteCount, const uint32 wayCount, const uint32 lineByteCount)
+	: _wayCount(wayCount)
+	, _lineShift(0)
+{
+	assert(0 == (lineByteCount & (lineByteCount - 1)));
+
+	while ((1u << _lineShift) < lineByteCount)
+	{
+		++_lineShift;
+	}
+
+	_setCount = std::max(1u, byteCount / (lineByteCount * wayCount));
+	reset();
+}
+
+void KdTreeCacheModel::access(const void* address, const uint32 byteCount)
+{
+	const uint64 firstByte = static_cast<uint64>(reinterpret_cast<uintptr_t>(address));
+	const uint64 firstLine = firstByte >> _lineShift;
+	const uint64 lastLine = (firstByte + byteCount - 1) >> _lineShift;
+
+	for (uint64 line = firstLine; line <= lastLine; ++line)
+	{
+		uint64* tags = _tagArray.data() + (line % _setCount) * _wayCount;
+
+		uint32 wayIndex = 0;
+		while ((wayIndex < _wayCount) && (line != tags[wayIndex]))
+		{
+			++wayIndex;
+		}
+
+		++_accessCount;
+		if (_wayCount == wayIndex)
+		{
+			++_missCount;
+			wayIndex = _wayCount - 1;
+		}
+
+		for (; 0 < wayIndex; --wayIndex)
+		{
+			tags[wayIndex] = tags[wayIndex - 1];
+		}
+		tags[0] = line;
+	}
+}
+
+void KdTreeCacheModel::reset()
+{
+	_tagArray.assign(_setCount * _wayCount, 0xffffffffffffffffULL);
+	_accessCount = 0;
+	_missCount = 0;
+}
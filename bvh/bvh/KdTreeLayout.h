@@ -0,0 +1,116 @@
+#pragma once
+
+#include "KdTree.h"
+#include <new>
+#include <stdint.h>
+
+enum class KdTreeNodeOrder : uint32
+{
+	// Note(jinpark) : pre-order, same as the packed layout. the reference for the others.
+	DepthFirst,
+
+	// Note(jinpark) : top _breadthFirstLevelCount levels level by level, the subtrees below them depth first.
+	BreadthFirst,
+
+	// Note(jinpark) : van Emde Boas, the tree is cut at half height and the top and every bottom subtree are laid out
+	//				   recursively. no block size, every cache level gets subtrees that fit it.
+	VanEmdeBoas,
+
+	// Note(jinpark) : blocks of _treeletByteCount. a treelet is grown from its root by the biggest surface area first,
+	//				   so the nodes a ray most likely visits next are in the same block, and is stored in pre-order inside it.
+	//				   subtrees that fit in what is left of a block are stored there whole, otherwise the block is padded.
+	Treelet,
+};
+
+struct KdTreeLayoutSettings
+{
+	KdTreeNodeOrder _order = KdTreeNodeOrder::DepthFirst;
+	uint32 _breadthFirstLevelCount = 8;
+	uint32 _treeletByteCount = 4096;	// Note(jinpark) : 64 for cache lines, 4096 for pages. a power of two up to kOrderedKdByteAlignment
+};
+
+const uint32 kOrderedKdInternalFlag = 0x80000000;
+const size_t kOrderedKdByteAlignment = 4096;
+
+// Note(jinpark) : vector storage aligned to kByteAlignment, so the blocks of a layout are real cache lines and pages.
+template <typename T, size_t kByteAlignment>
+class KdTreeAlignedAllocator
+{
+public:
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef KdTreeAlignedAllocator<U, kByteAlignment> other;
+	};
+
+	KdTreeAlignedAllocator() = default;
+	template <typename U>
+	KdTreeAlignedAllocator(const KdTreeAlignedAllocator<U, kByteAlignment>&) {}
+
+	// Note(jinpark) : the pointer from operator new is kept just before the aligned one.
+	T* allocate(const size_t count)
+	{
+		char* block = static_cast<char*>(::operator new(count * sizeof(T) + kByteAlignment + sizeof(void*)));
+		const uintptr_t aligned = (reinterpret_cast<uintptr_t>(block) + sizeof(void*) + kByteAlignment - 1) & ~static_cast<uintptr_t>(kByteAlignment - 1);
+		reinterpret_cast<void**>(aligned)[-1] = block;
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	void deallocate(T* pointer, const size_t)
+	{
+		::operator delete(reinterpret_cast<void**>(pointer)[-1]);
+	}
+
+	template <typename U>
+	bool operator==(const KdTreeAlignedAllocator<U, kByteAlignment>&) const { return true; }
+	template <typename U>
+	bool operator!=(const KdTreeAlignedAllocator<U, kByteAlignment>&) const { return false; }
+};
+
+// Note(jinpark) : 2 per node in the chosen order, then position0 per primitive as in the packed layout.
+//				   internal node (bbMin, kOrderedKdInternalFlag | childIndex), (bbMax, nextIndex)
+//				   leaf node (edge0, primitiveIndex), (edge1, nextIndex)
+//				   the walk is the pre-order one whatever the order, childIndex is taken on a hit and
+//				   nextIndex (skip pointer, 0xffffffff ends) on a miss or after a leaf.
+//				   _nodeCount counts padding slots too, nothing points at them.
+struct OrderedKdTree
+{
+	KdTreeNodeOrder _order = KdTreeNodeOrder::DepthFirst;
+	uint32 _nodeCount = 0;
+	std::vector<PackedKdNode, KdTreeAlignedAllocator<PackedKdNode, kOrderedKdByteAlignment>> _nodeArray;
+};
+
+class KdTreeLayout
+{
+public:
+	static void build(OrderedKdTree& outOrderedTree, const PackedKdNode* packedNodes, const uint32 packedNodeCount, const KdTreeLayoutSettings& settings);
+
+	// Note(jinpark) : outNodeOrder[packed node index] = node index in the layout, outNodeCount includes padding.
+	static void buildNodeOrder(std::vector<uint32>& outNodeOrder, uint32& outNodeCount, const PackedKdNode* packedNodes, const uint32 packedNodeCount, const KdTreeLayoutSettings& settings);
+};
+
+// Note(jinpark) : set associative LRU cache model, fed with the addresses a traversal reads.
+//				   only for comparing layouts, the numbers are line fills not hardware counters.
+class KdTreeCacheModel
+{
+public:
+	explicit KdTreeCacheModel(const uint32 byteCount = 32 << 10, const uint32 wayCount = 8, const uint32 lineByteCount = 64);
+
+	void access(const void* address, const uint32 byteCount);
+	void reset();
+
+	uint64 getAccessCount() const { return _accessCount; }
+	uint64 getMissCount() const { return _missCount; }
+
+private:
+	uint32 _wayCount;
+	uint32 _setCount;
+	uint32 _lineShift;
+
+	std::vector<uint64> _tagArray;	// Note(jinpark) : _wayCount per set, most recently used first.
+
+	uint64 _accessCount = 0;
+	uint64 _missCount = 0;
+};
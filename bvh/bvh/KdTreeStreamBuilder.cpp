@@ -0,0 +1,695 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "KdTreeStreamBuilder.h"
+#include "KdTreeFile.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+const float kMaxBoxLength = 1000000.0f;
+const uint32 kCopyBufferByteCount = 1 << 20;
+
+struct StreamTriangle
+{
+	float3 _positions[3];
+	uint64 _primitiveIndex;
+};
+
+struct StreamCluster
+{
+	std::string _filePath;
+	uint64 _triangleCount = 0;
+
+	float3 _bbMin = float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength);
+	float3 _bbMax = float3(-kMaxBoxLength, -kMaxBoxLength, -kMaxBoxLength);
+	float3 _centerMin = float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength);
+	float3 _centerMax = float3(-kMaxBoxLength, -kMaxBoxLength, -kMaxBoxLength);
+};
+
+// Note(jinpark) : cluster files of one build. names carry the process id and a per process build serial,
+//				   so builds sharing a temp directory never open each other's files.
+//				   every file created is removed when the build returns, on failure as well.
+class StreamTempFiles
+{
+public:
+	explicit StreamTempFiles(const std::string& directoryPath)
+	{
+		static std::atomic<uint32> buildSerial{ 0 };
+		_prefix = directoryPath + "/kdtree_" + std::to_string(getpid()) + "_" + std::to_string(buildSerial.fetch_add(1)) + "_cluster_";
+	}
+
+	~StreamTempFiles()
+	{
+		for (const std::string& filePath : _filePathArray)
+		{
+			remove(filePath.c_str());
+		}
+	}
+
+	DISALLOW_ASSIGN_COPY(StreamTempFiles);
+
+public:
+	std::string create()
+	{
+		_filePathArray.push_back(_prefix + std::to_string(_filePathArray.size()) + ".tmp");
+		return _filePathArray.back();
+	}
+
+private:
+	std::string _prefix;
+	std::vector<std::string> _filePathArray;
+};
+
+// Note(jinpark) : the tree over the clusters, one cluster per leaf. pre-order, so a subtree is [topNodeIndex, getEndIndex(topNodeIndex)).
+struct StreamTopTree
+{
+	std::vector<RangeKdNode> _nodeArray;
+	std::vector<uint32> _clusterIndexArray;		// Note(jinpark) : per node, 0xffffffff for internal nodes
+	std::vector<uint64> _primitiveOffsetArray;	// Note(jinpark) : triangles in the clusters before every node, node count + 1 entries
+
+	uint32 getEndIndex(const uint32 topNodeIndex) const
+	{
+		const uint32 nextNodeIndex = _nodeArray[topNodeIndex]._nextNodeIndex;
+		return (0xffffffff == nextNodeIndex) ? static_cast<uint32>(_nodeArray.size()) : nextNodeIndex;
+	}
+
+	uint64 getPrimitiveCount(const uint32 topNodeIndex) const
+	{
+		return _primitiveOffsetArray[getEndIndex(topNodeIndex)] - _primitiveOffsetArray[topNodeIndex];
+	}
+};
+
+typedef std::function<uint32(StreamTriangle* outTriangles, const uint32 maxTriangleCount)> StreamReader;
+
+static float3 computeCenter(const StreamTriangle& triangle)
+{
+	const float3 bbMin = float3::Min(float3::Min(triangle._positions[0], triangle._positions[1]), triangle._positions[2]);
+	const float3 bbMax = float3::Max(float3::Max(triangle._positions[0], triangle._positions[1]), triangle._positions[2]);
+	return (bbMin + bbMax) * 0.5f;
+}
+
+static bool writeFile(FILE* file, const void* data, const size_t size, const size_t count)
+{
+	return (0 == count) || (count == fwrite(data, size, count, file));
+}
+
+static bool writePadding(FILE* file, const uint64 fileOffset, const uint64 alignedOffset)
+{
+	static const uint8_t kZeroBytes[kKdTreeFileAlignment] = {};
+
+	assert((fileOffset <= alignedOffset) && (alignedOffset - fileOffset < kKdTreeFileAlignment));
+	return writeFile(file, kZeroBytes, 1, static_cast<size_t>(alignedOffset - fileOffset));
+}
+
+static uint64 alignOffset(const uint64 fileOffset)
+{
+	return (fileOffset + kKdTreeFileAlignment - 1) / kKdTreeFileAlignment * kKdTreeFileAlignment;
+}
+
+// Note(jinpark) : copies sourceFile from its start to the end of outFile.
+static bool appendFile(FILE* outFile, FILE* sourceFile)
+{
+	std::vector<uint8_t> bufferArray(kCopyBufferByteCount);
+
+	rewind(sourceFile);
+	for (size_t readCount = fread(bufferArray.data(), 1, kCopyBufferByteCount, sourceFile); 0 != readCount; readCount = fread(bufferArray.data(), 1, kCopyBufferByteCount, sourceFile))
+	{
+		if (false == writeFile(outFile, bufferArray.data(), 1, readCount))
+		{
+			return false;
+		}
+	}
+
+	return (0 == ferror(sourceFile));
+}
+
+// Note(jinpark) : rename over an existing file, in one step where the platform allows it.
+static bool replaceFile(const std::string& sourceFilePath, const std::string& destFilePath)
+{
+#if defined(_WIN32)
+	return (FALSE != MoveFileExA(sourceFilePath.c_str(), destFilePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH));
+#else
+	return (0 == rename(sourceFilePath.c_str(), destFilePath.c_str()));
+#endif
+}
+
+static bool binTriangles(std::vector<StreamCluster>& outClusterArray, const StreamReader& reader, const float3& centerMin, const float3& centerMax, const KdTreeStreamSettings& settings, StreamTempFiles& tempFiles)
+{
+	const uint32 resolution = std::max(1u, settings._clusterResolution);
+	const uint32 cellCount = resolution * resolution * resolution;
+
+	std::vector<StreamCluster> cellArray(cellCount);
+
+	const float3 extents = centerMax - centerMin;
+	float3 cellScale;
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		cellScale[axisIndex] = (0.0f < extents[axisIndex]) ? (static_cast<float>(resolution) / extents[axisIndex]) : 0.0f;
+	}
+
+	const uint32 chunkTriangleCount = std::max(1u, settings._chunkTriangleCount);
+	std::vector<StreamTriangle> chunkArray(chunkTriangleCount);
+	std::vector<StreamTriangle> sortedChunkArray(chunkTriangleCount);
+	std::vector<uint32> cellIndexArray(chunkTriangleCount);
+	std::vector<uint32> cellOffsetArray(cellCount + 1);
+
+	for (uint32 readCount = reader(chunkArray.data(), chunkTriangleCount); 0 != readCount; readCount = reader(chunkArray.data(), chunkTriangleCount))
+	{
+		// Note(jinpark) : counting sort by cell, so every cell file is opened once per chunk.
+		std::fill(cellOffsetArray.begin(), cellOffsetArray.end(), 0);
+		for (uint32 i = 0; i < readCount; ++i)
+		{
+			const float3 center = computeCenter(chunkArray[i]);
+
+			uint32 cellCoord[3];
+			for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+			{
+				const float cell = (center[axisIndex] - centerMin[axisIndex]) * cellScale[axisIndex];
+				cellCoord[axisIndex] = std::min(resolution - 1, static_cast<uint32>(std::max(0.0f, cell)));
+			}
+
+			const uint32 cellIndex = (cellCoord[2] * resolution + cellCoord[1]) * resolution + cellCoord[0];
+			cellIndexArray[i] = cellIndex;
+			++cellOffsetArray[cellIndex + 1];
+
+			StreamCluster& cell = cellArray[cellIndex];
+			for (uint32 k = 0; k < 3; ++k)
+			{
+				cell._bbMin = float3::Min(cell._bbMin, chunkArray[i]._positions[k]);
+				cell._bbMax = float3::Max(cell._bbMax, chunkArray[i]._positions[k]);
+			}
+			cell._centerMin = float3::Min(cell._centerMin, center);
+			cell._centerMax = float3::Max(cell._centerMax, center);
+		}
+
+		for (uint32 cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			cellOffsetArray[cellIndex + 1] += cellOffsetArray[cellIndex];
+		}
+
+		std::vector<uint32> cursorArray(cellOffsetArray.begin(), cellOffsetArray.end() - 1);
+		for (uint32 i = 0; i < readCount; ++i)
+		{
+			sortedChunkArray[cursorArray[cellIndexArray[i]]++] = chunkArray[i];
+		}
+
+		for (uint32 cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+		{
+			const uint32 runCount = cellOffsetArray[cellIndex + 1] - cellOffsetArray[cellIndex];
+			if (0 == runCount)
+			{
+				continue;
+			}
+
+			StreamCluster& cell = cellArray[cellIndex];
+			if (true == cell._filePath.empty())
+			{
+				cell._filePath = tempFiles.create();
+				remove(cell._filePath.c_str());
+			}
+
+			FILE* file = fopen(cell._filePath.c_str(), "ab");
+			if (nullptr == file)
+			{
+				return false;
+			}
+
+			const bool isWritten = writeFile(file, &sortedChunkArray[cellOffsetArray[cellIndex]], sizeof(StreamTriangle), runCount);
+			fclose(file);
+			if (false == isWritten)
+			{
+				return false;
+			}
+
+			cell._triangleCount += runCount;
+		}
+	}
+
+	for (StreamCluster& cell : cellArray)
+	{
+		if (0 != cell._triangleCount)
+		{
+			outClusterArray.push_back(cell);
+		}
+	}
+
+	return true;
+}
+
+static bool loadCluster(std::vector<StreamTriangle>& outTriangleArray, const StreamCluster& cluster)
+{
+	outTriangleArray.resize(cluster._triangleCount);
+
+	FILE* file = fopen(cluster._filePath.c_str(), "rb");
+	if (nullptr == file)
+	{
+		return false;
+	}
+
+	const size_t readCount = fread(outTriangleArray.data(), sizeof(StreamTriangle), cluster._triangleCount, file);
+	fclose(file);
+
+	return (readCount == cluster._triangleCount);
+}
+
+static bool splitClusters(std::vector<StreamCluster>& clusterArray, const KdTreeStreamSettings& settings, StreamTempFiles& tempFiles)
+{
+	std::vector<StreamCluster> pendingArray = static_cast<std::vector<StreamCluster>&&>(clusterArray);
+	clusterArray.clear();
+
+	while (false == pendingArray.empty())
+	{
+		StreamCluster cluster = pendingArray.back();
+		pendingArray.pop_back();
+
+		// Note(jinpark) : coincident centers cannot be binned any further, such cluster is built as it is.
+		const bool isDegenerated = (cluster._centerMax - cluster._centerMin) == float3::Zero();
+		if ((cluster._triangleCount <= settings._maxClusterTriangleCount) || (true == isDegenerated))
+		{
+			clusterArray.push_back(cluster);
+			continue;
+		}
+
+		FILE* file = fopen(cluster._filePath.c_str(), "rb");
+		if (nullptr == file)
+		{
+			return false;
+		}
+
+		StreamReader reader = [file](StreamTriangle* outTriangles, const uint32 maxTriangleCount)
+		{
+			return static_cast<uint32>(fread(outTriangles, sizeof(StreamTriangle), maxTriangleCount, file));
+		};
+
+		const uint32 prevClusterCount = static_cast<uint32>(pendingArray.size());
+		const bool isBinned = binTriangles(pendingArray, reader, cluster._centerMin, cluster._centerMax, settings, tempFiles);
+		fclose(file);
+		remove(cluster._filePath.c_str());
+
+		if (false == isBinned)
+		{
+			return false;
+		}
+
+		// Note(jinpark) : everything fell into one cell (very uneven density), accept it to guarantee progress.
+		if (static_cast<uint32>(pendingArray.size()) == prevClusterCount + 1)
+		{
+			clusterArray.push_back(pendingArray.back());
+			pendingArray.pop_back();
+		}
+	}
+
+	return true;
+}
+
+// Note(jinpark) : builds the clusters of the top level subtree [beginIndex, endIndex) one by one and writes their packed tree,
+//				   the position0 table last. a top level leaf is replaced by the (2n - 1) nodes of its cluster, primitives are
+//				   numbered in the same order so the position0 table is written sequentially. position0._parameter1 is the source
+//				   index, with primitiveIndexFile it is the index in this tree and the uint64 source index goes to the file.
+static bool writePackedTree(FILE* outFile, FILE* primitiveIndexFile, const std::string& positionFilePath, const StreamTopTree& topTree, const std::vector<StreamCluster>& clusterArray, const uint32 beginIndex, const uint32 endIndex)
+{
+	std::vector<uint32> outNodeIndexArray(endIndex - beginIndex);
+	std::vector<uint32> primitiveBaseArray(endIndex - beginIndex);
+
+	uint32 outNodeCount = 0;
+	uint32 outPrimitiveCount = 0;
+	for (uint32 topNodeIndex = beginIndex; topNodeIndex < endIndex; ++topNodeIndex)
+	{
+		outNodeIndexArray[topNodeIndex - beginIndex] = outNodeCount;
+		primitiveBaseArray[topNodeIndex - beginIndex] = outPrimitiveCount;
+
+		const uint32 clusterIndex = topTree._clusterIndexArray[topNodeIndex];
+		if (0xffffffff != clusterIndex)
+		{
+			const uint32 clusterTriangleCount = static_cast<uint32>(clusterArray[clusterIndex]._triangleCount);
+			outNodeCount += clusterTriangleCount * 2 - 1;
+			outPrimitiveCount += clusterTriangleCount;
+		}
+		else
+		{
+			outNodeCount += 1;
+		}
+	}
+
+	assert(outNodeCount == outPrimitiveCount * 2 - 1);
+
+	// Note(jinpark) : skip targets past the subtree end the walk of this tree.
+	auto toOutNodeIndex = [&outNodeIndexArray, beginIndex, endIndex](uint32 topNodeIndex)
+	{
+		return ((0xffffffff == topNodeIndex) || (endIndex <= topNodeIndex)) ? 0xffffffff : outNodeIndexArray[topNodeIndex - beginIndex];
+	};
+
+	FILE* positionFile = fopen(positionFilePath.c_str(), "w+b");
+	bool isSucceeded = (nullptr != positionFile);
+
+	KdTree kdTree;
+	std::vector<StreamTriangle> triangleArray;
+	std::vector<float3> vertexArray;
+	std::vector<uint32> indexArray;
+	std::vector<uint64> sourceIndexArray;
+	std::vector<PackedKdNode> packedNodeArray;
+
+	for (uint32 topNodeIndex = beginIndex; (topNodeIndex < endIndex) && isSucceeded; ++topNodeIndex)
+	{
+		const RangeKdNode& topNode = topTree._nodeArray[topNodeIndex];
+		const uint32 nextNodeIndex = toOutNodeIndex(topNode._nextNodeIndex);
+
+		const uint32 clusterIndex = topTree._clusterIndexArray[topNodeIndex];
+		if (0xffffffff == clusterIndex)
+		{
+			PackedKdNode packedNodes[2];
+			packedNodes[0]._parameter0 = topNode._bbMin;
+			packedNodes[0]._parameter1 = 0xffffffff;
+			packedNodes[1]._parameter0 = topNode._bbMax;
+			packedNodes[1]._parameter1 = nextNodeIndex;
+
+			isSucceeded = writeFile(outFile, packedNodes, sizeof(PackedKdNode), 2);
+			continue;
+		}
+
+		const StreamCluster& cluster = clusterArray[clusterIndex];
+		if (false == loadCluster(triangleArray, cluster))
+		{
+			isSucceeded = false;
+			break;
+		}
+
+		const uint32 clusterTriangleCount = static_cast<uint32>(cluster._triangleCount);
+		vertexArray.resize(clusterTriangleCount * 3);
+		indexArray.resize(clusterTriangleCount * 3);
+		for (uint32 i = 0; i < clusterTriangleCount * 3; ++i)
+		{
+			vertexArray[i] = triangleArray[i / 3]._positions[i % 3];
+			indexArray[i] = i;
+		}
+
+		kdTree.build(packedNodeArray, vertexArray.data(), sizeof(float3), indexArray.data(), clusterTriangleCount * 3);
+
+		// Note(jinpark) : relocate cluster local indices into the final layout
+		const uint32 clusterNodeCount = clusterTriangleCount * 2 - 1;
+		const uint32 clusterNodeBase = outNodeIndexArray[topNodeIndex - beginIndex];
+		const uint32 primitiveBase = primitiveBaseArray[topNodeIndex - beginIndex];
+
+		for (uint32 nodeIndex = 0; nodeIndex < clusterNodeCount; ++nodeIndex)
+		{
+			PackedKdNode& packedNode0 = packedNodeArray[nodeIndex * 2 + 0];
+			PackedKdNode& packedNode1 = packedNodeArray[nodeIndex * 2 + 1];
+
+			const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+			if (true == isLeafNode)
+			{
+				const uint32 localPrimitiveIndex = packedNode0._parameter1 - clusterNodeCount * 2;
+				packedNode0._parameter1 = primitiveBase + localPrimitiveIndex + outNodeCount * 2;
+			}
+
+			packedNode1._parameter1 = (0xffffffff == packedNode1._parameter1) ? nextNodeIndex : (clusterNodeBase + packedNode1._parameter1);
+		}
+
+		sourceIndexArray.resize(clusterTriangleCount);
+		for (uint32 i = 0; i < clusterTriangleCount; ++i)
+		{
+			sourceIndexArray[i] = triangleArray[i]._primitiveIndex;
+			packedNodeArray[clusterNodeCount * 2 + i]._parameter1 = (nullptr == primitiveIndexFile) ? static_cast<uint32>(sourceIndexArray[i]) : (primitiveBase + i);
+		}
+
+		isSucceeded = writeFile(outFile, packedNodeArray.data(), sizeof(PackedKdNode), clusterNodeCount * 2)
+			&& writeFile(positionFile, packedNodeArray.data() + clusterNodeCount * 2, sizeof(PackedKdNode), clusterTriangleCount)
+			&& ((nullptr == primitiveIndexFile) || writeFile(primitiveIndexFile, sourceIndexArray.data(), sizeof(uint64), clusterTriangleCount));
+
+		remove(cluster._filePath.c_str());
+	}
+
+	// Note(jinpark) : append position0 table
+	isSucceeded = isSucceeded && appendFile(outFile, positionFile);
+
+	if (nullptr != positionFile)
+	{
+		fclose(positionFile);
+	}
+	remove(positionFilePath.c_str());
+
+	return isSucceeded;
+}
+
+static bool writePackedFile(FILE* outFile, const std::string& positionFilePath, const StreamTopTree& topTree, const std::vector<StreamCluster>& clusterArray)
+{
+	const uint32 topNodeCount = static_cast<uint32>(topTree._nodeArray.size());
+	const uint32 primitiveCount = static_cast<uint32>(topTree._primitiveOffsetArray[topNodeCount]);
+
+	KdTreeFileHeader header;
+	KdTreeFile::buildHeader(header, KdTree::getPackedNodeCount(primitiveCount), topTree._nodeArray[0]._bbMin, topTree._nodeArray[0]._bbMax, KdTreeFile::getDefaultBuildConfigHash());
+	header._flags |= kKdTreeFileFlagSourcePrimitiveIndex;
+
+	return writeFile(outFile, &header, sizeof(KdTreeFileHeader), 1)
+		&& writePackedTree(outFile, nullptr, positionFilePath, topTree, clusterArray, 0, topNodeCount);
+}
+
+// Note(jinpark) : the top level subtrees that fit maxSegmentPrimitiveCount are the segments, the nodes above them the top tree.
+static bool writeSegmentedFile(FILE* outFile, const std::string& positionFilePath, const std::string& primitiveIndexFilePath, const StreamTopTree& topTree, const std::vector<StreamCluster>& clusterArray, const uint32 maxSegmentPrimitiveCount)
+{
+	const uint32 topNodeCount = static_cast<uint32>(topTree._nodeArray.size());
+
+	// Note(jinpark) : 1 step - pre-order walk that does not enter segments. the kept nodes stay in pre-order
+	//				   and the skip target of a kept node is kept as well.
+	std::vector<uint32> outNodeIndexArray(topNodeCount, 0xffffffff);
+	std::vector<uint32> keptNodeArray;
+	std::vector<uint32> segmentRootArray;
+
+	for (uint32 topNodeIndex = 0; topNodeIndex < topNodeCount; )
+	{
+		outNodeIndexArray[topNodeIndex] = static_cast<uint32>(keptNodeArray.size());
+		keptNodeArray.push_back(topNodeIndex);
+
+		if (topTree.getPrimitiveCount(topNodeIndex) <= maxSegmentPrimitiveCount)
+		{
+			segmentRootArray.push_back(topNodeIndex);
+			topNodeIndex = topTree.getEndIndex(topNodeIndex);
+			continue;
+		}
+
+		// Note(jinpark) : a cluster of coincident centers is never split, one above the segment size can not be written.
+		if (0xffffffff != topTree._clusterIndexArray[topNodeIndex])
+		{
+			return false;
+		}
+
+		++topNodeIndex;
+	}
+
+	const uint32 segmentCount = static_cast<uint32>(segmentRootArray.size());
+	const uint32 topPackedNodeCount = static_cast<uint32>(keptNodeArray.size()) * 2;
+	assert(topPackedNodeCount == (segmentCount * 2 - 1) * 2);
+
+	// Note(jinpark) : 2 step - segment table, every segment and the source index table start aligned
+	std::vector<KdTreeFileSegment> segmentArray(segmentCount);
+
+	uint64 fileOffset = sizeof(KdTreeFileHeader) + static_cast<uint64>(topPackedNodeCount) * sizeof(PackedKdNode) + static_cast<uint64>(segmentCount) * sizeof(KdTreeFileSegment);
+	uint64 primitiveBase = 0;
+	for (uint32 segmentIndex = 0; segmentIndex < segmentCount; ++segmentIndex)
+	{
+		const uint32 primitiveCount = static_cast<uint32>(topTree.getPrimitiveCount(segmentRootArray[segmentIndex]));
+
+		KdTreeFileSegment& segment = segmentArray[segmentIndex];
+		segment = KdTreeFileSegment();
+		segment._packedNodeOffset = alignOffset(fileOffset);
+		segment._primitiveBase = primitiveBase;
+		segment._packedNodeCount = KdTree::getPackedNodeCount(primitiveCount);
+		segment._primitiveCount = primitiveCount;
+
+		fileOffset = segment._packedNodeOffset + static_cast<uint64>(segment._packedNodeCount) * sizeof(PackedKdNode);
+		primitiveBase += primitiveCount;
+	}
+
+	KdTreeFileHeader header;
+	KdTreeFile::buildHeader(header, 0, topTree._nodeArray[0]._bbMin, topTree._nodeArray[0]._bbMax, KdTreeFile::getDefaultBuildConfigHash());
+	header._packedNodeCount = topPackedNodeCount;
+	header._primitiveCount = segmentCount;
+	header._flags |= kKdTreeFileFlagSegmented;
+	header._primitiveIndexOffset = alignOffset(fileOffset);
+
+	// Note(jinpark) : 3 step - top tree, leaf (bbMin, segmentIndex), (bbMax, next) as in SegmentedKdTree
+	std::vector<PackedKdNode> topPackedNodeArray(topPackedNodeCount);
+
+	uint32 nextSegmentIndex = 0;
+	for (uint32 keptIndex = 0; keptIndex < static_cast<uint32>(keptNodeArray.size()); ++keptIndex)
+	{
+		const uint32 topNodeIndex = keptNodeArray[keptIndex];
+		const RangeKdNode& topNode = topTree._nodeArray[topNodeIndex];
+
+		const bool isSegmentNode = (nextSegmentIndex < segmentCount) && (segmentRootArray[nextSegmentIndex] == topNodeIndex);
+
+		topPackedNodeArray[keptIndex * 2 + 0]._parameter0 = topNode._bbMin;
+		topPackedNodeArray[keptIndex * 2 + 0]._parameter1 = (true == isSegmentNode) ? nextSegmentIndex++ : 0xffffffff;
+		topPackedNodeArray[keptIndex * 2 + 1]._parameter0 = topNode._bbMax;
+		topPackedNodeArray[keptIndex * 2 + 1]._parameter1 = (0xffffffff == topNode._nextNodeIndex) ? 0xffffffff : outNodeIndexArray[topNode._nextNodeIndex];
+	}
+
+	bool isSucceeded = writeFile(outFile, &header, sizeof(KdTreeFileHeader), 1)
+		&& writeFile(outFile, topPackedNodeArray.data(), sizeof(PackedKdNode), topPackedNodeCount)
+		&& writeFile(outFile, segmentArray.data(), sizeof(KdTreeFileSegment), segmentCount);
+
+	// Note(jinpark) : 4 step - segments, then the source index table
+	FILE* primitiveIndexFile = fopen(primitiveIndexFilePath.c_str(), "w+b");
+	isSucceeded = isSucceeded && (nullptr != primitiveIndexFile);
+
+	fileOffset = sizeof(KdTreeFileHeader) + static_cast<uint64>(topPackedNodeCount) * sizeof(PackedKdNode) + static_cast<uint64>(segmentCount) * sizeof(KdTreeFileSegment);
+	for (uint32 segmentIndex = 0; (segmentIndex < segmentCount) && isSucceeded; ++segmentIndex)
+	{
+		const KdTreeFileSegment& segment = segmentArray[segmentIndex];
+		const uint32 rootIndex = segmentRootArray[segmentIndex];
+
+		isSucceeded = writePadding(outFile, fileOffset, segment._packedNodeOffset)
+			&& writePackedTree(outFile, primitiveIndexFile, positionFilePath, topTree, clusterArray, rootIndex, topTree.getEndIndex(rootIndex));
+
+		fileOffset = segment._packedNodeOffset + static_cast<uint64>(segment._packedNodeCount) * sizeof(PackedKdNode);
+	}
+
+	isSucceeded = isSucceeded
+		&& writePadding(outFile, fileOffset, header._primitiveIndexOffset)
+		&& appendFile(outFile, primitiveIndexFile);
+
+	if (nullptr != primitiveIndexFile)
+	{
+		fclose(primitiveIndexFile);
+	}
+	remove(primitiveIndexFilePath.c_str());
+
+	return isSucceeded;
+}
+
+bool KdTreeStreamBuilder::build(const std::string& outFilePath, KdTreeTriangleSource& source, const KdTreeStreamSettings& settings)
+{
+	const uint32 chunkTriangleCount = std::max(1u, settings._chunkTriangleCount);
+	std::vector<float3> positionArray(chunkTriangleCount * 3);
+
+	// Note(jinpark) : 1 step - center bounds and triangle count
+	uint64_t triangleCount = 0;
+	float3 centerMin = float3(kMaxBoxLength, kMaxBoxLength, kMaxBoxLength);
+	float3 centerMax = -centerMin;
+
+	source.rewind();
+	for (uint32 readCount = source.read(positionArray.data(), chunkTriangleCount); 0 != readCount; readCount = source.read(positionArray.data(), chunkTriangleCount))
+	{
+		for (uint32 i = 0; i < readCount; ++i)
+		{
+			StreamTriangle triangle = { { positionArray[i * 3 + 0], positionArray[i * 3 + 1], positionArray[i * 3 + 2] }, 0 };
+			const float3 center = computeCenter(triangle);
+			centerMin = float3::Min(centerMin, center);
+			centerMax = float3::Max(centerMax, center);
+		}
+
+		triangleCount += readCount;
+	}
+
+	if (0 == triangleCount)
+	{
+		return false;
+	}
+
+	// Note(jinpark) : 2 step - bin triangles into cluster files
+	std::vector<StreamCluster> clusterArray;
+	StreamTempFiles tempFiles(settings._tempDirectoryPath);
+	{
+		uint64 primitiveIndex = 0;
+		StreamReader reader = [&source, &positionArray, &primitiveIndex](StreamTriangle* outTriangles, const uint32 maxTriangleCount)
+		{
+			const uint32 readCount = source.read(positionArray.data(), maxTriangleCount);
+			for (uint32 i = 0; i < readCount; ++i)
+			{
+				outTriangles[i] = { { positionArray[i * 3 + 0], positionArray[i * 3 + 1], positionArray[i * 3 + 2] }, primitiveIndex++ };
+			}
+			return readCount;
+		};
+
+		source.rewind();
+		if (false == binTriangles(clusterArray, reader, centerMin, centerMax, settings, tempFiles))
+		{
+			return false;
+		}
+
+		if (false == splitClusters(clusterArray, settings, tempFiles))
+		{
+			return false;
+		}
+	}
+
+	// Note(jinpark) : 3 step - top level tree, one cluster per leaf
+	const uint32 clusterCount = static_cast<uint32>(clusterArray.size());
+
+	KdPrimitiveArray clusterPrimitiveArray;
+	clusterPrimitiveArray._bbMinArray.resize(clusterCount);
+	clusterPrimitiveArray._bbMaxArray.resize(clusterCount);
+	clusterPrimitiveArray._primitiveIndexArray.resize(clusterCount);
+	for (uint32 clusterIndex = 0; clusterIndex < clusterCount; ++clusterIndex)
+	{
+		clusterPrimitiveArray._bbMinArray[clusterIndex] = clusterArray[clusterIndex]._bbMin;
+		clusterPrimitiveArray._bbMaxArray[clusterIndex] = clusterArray[clusterIndex]._bbMax;
+		clusterPrimitiveArray._primitiveIndexArray[clusterIndex] = clusterIndex;
+	}
+
+	StreamTopTree topTree;
+	KdTree::buildRangeNodeArray(topTree._nodeArray, clusterPrimitiveArray, 1);
+
+	const uint32 topNodeCount = static_cast<uint32>(topTree._nodeArray.size());
+	topTree._clusterIndexArray.resize(topNodeCount);
+	topTree._primitiveOffsetArray.resize(topNodeCount + 1);
+	topTree._primitiveOffsetArray[0] = 0;
+	for (uint32 topNodeIndex = 0; topNodeIndex < topNodeCount; ++topNodeIndex)
+	{
+		const RangeKdNode& topNode = topTree._nodeArray[topNodeIndex];
+
+		const bool isClusterNode = (0xffffffff != topNode._primitiveIndex);
+		const uint32 clusterIndex = (true == isClusterNode) ? clusterPrimitiveArray._primitiveIndexArray[topNode._beginIndex] : 0xffffffff;
+
+		topTree._clusterIndexArray[topNodeIndex] = clusterIndex;
+		topTree._primitiveOffsetArray[topNodeIndex + 1] = topTree._primitiveOffsetArray[topNodeIndex] + ((true == isClusterNode) ? clusterArray[clusterIndex]._triangleCount : 0);
+	}
+
+	// Note(jinpark) : 4 step - one packed tree if it can index every triangle, segments otherwise.
+	//				   the tree is written aside and renamed at the end, a failed build keeps the previous file.
+	const std::string tempFilePath = outFilePath + ".tmp";
+	const std::string positionFilePath = outFilePath + ".position.tmp";
+	const std::string primitiveIndexFilePath = outFilePath + ".index.tmp";
+
+	const uint32 maxSegmentPrimitiveCount = std::min(std::max(1u, settings._maxSegmentPrimitiveCount), kMaxSegmentPrimitiveCount);
+
+	FILE* outFile = fopen(tempFilePath.c_str(), "wb");
+	bool isSucceeded = (nullptr != outFile);
+
+	if (true == isSucceeded)
+	{
+		if (topTree._primitiveOffsetArray[topNodeCount] <= maxSegmentPrimitiveCount)
+		{
+			isSucceeded = writePackedFile(outFile, positionFilePath, topTree, clusterArray);
+		}
+		else
+		{
+			isSucceeded = writeSegmentedFile(outFile, positionFilePath, primitiveIndexFilePath, topTree, clusterArray, maxSegmentPrimitiveCount);
+		}
+	}
+
+	if (nullptr != outFile)
+	{
+		isSucceeded = (0 == fclose(outFile)) && isSucceeded;
+	}
+
+	isSucceeded = isSucceeded && replaceFile(tempFilePath, outFilePath);
+	if (false == isSucceeded)
+	{
+		remove(tempFilePath.c_str());
+	}
+
+	return isSucceeded;
+}
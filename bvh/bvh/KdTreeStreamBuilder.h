@@ -0,0 +1,37 @@
+#pragma once
+
+#include "KdTree.h"
+#include <string>
+
+class KdTreeTriangleSource
+{
+public:
+	virtual ~KdTreeTriangleSource() = default;
+
+	virtual void rewind() = 0;
+
+	// Note(jinpark) : writes 3 positions per triangle, returns 0 at the end of the stream.
+	virtual uint32 read(float3* outPositions, const uint32 maxTriangleCount) = 0;
+};
+
+struct KdTreeStreamSettings
+{
+	std::string _tempDirectoryPath = ".";	// Note(jinpark) : may be shared by concurrent builds
+
+	uint32 _chunkTriangleCount = 1 << 20;
+	uint32 _clusterResolution = 8;
+	uint32 _maxClusterTriangleCount = 1 << 22;
+	uint32 _maxSegmentPrimitiveCount = kMaxSegmentPrimitiveCount;	// Note(jinpark) : above it the output is segmented
+};
+
+// Note(jinpark) : out-of-core build. triangles are read in chunks, binned into spatial clusters on disk,
+//				   each cluster is built alone with KdTree and a top level tree is built over the clusters.
+//				   the output is a KdTreeFile of the same packed layout as KdTree::build, but primitive order follows the clusters,
+//				   position0._parameter1 maps it back to the source triangle index (kKdTreeFileFlagSourcePrimitiveIndex).
+//				   more triangles than one packed tree can index (billions) are written as segments (kKdTreeFileFlagSegmented),
+//				   top level subtrees that fit a segment. KdTreeTraversal reads either output in place.
+class KdTreeStreamBuilder
+{
+public:
+	static bool build(const std::string& outFilePath, KdTreeTriangleSource& source, const KdTreeStreamSettings& settings = KdTreeStreamSettings());
+};
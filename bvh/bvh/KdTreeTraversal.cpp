@@ -0,0 +1,1273 @@
+#include "KdTreeTraversal.h"
+#include "KdTreeFile.h"
+#include "Half.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Note(jinpark) : F16C is picked at run time, some AVX CPUs (Sandy Bridge, Jaguar) do not have it and the project sets no /arch.
+//				   only the F16C half traversal is compiled for that target, gcc/clang need flatten to pull the traversal
+//				   and the decode into it. CPUs without F16C decode with the Half class.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define KD_TREE_USE_F16C 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define KD_TREE_F16C_TARGET
+#else
+#define KD_TREE_F16C_TARGET __attribute__((target("avx,f16c"), flatten))
+#endif
+#else
+#define KD_TREE_USE_F16C 0
+#endif
+
+#include <xmmintrin.h>
+
+const float kTriangleEpsilon = 1e-8f;
+
+uint32 KdTreeTraversal::getPrimitiveCount(const uint32 packedNodeCount)
+{
+	// Note(jinpark) : packed size = kdNodeCount * 2 + primitiveCount, kdNodeCount = primitiveCount * 2 - 1
+	if (0 == packedNodeCount)
+	{
+		return 0;
+	}
+
+	assert(0 == ((packedNodeCount + 2) % 5));
+	return (packedNodeCount + 2) / 5;
+}
+
+// Note(jinpark) : (1 + 2 * gamma(3)), gamma(n) = n * u / (1 - n * u) with u the unit roundoff.
+const float kBoxFarScale = 1.0f + 2.0f * (3.0f * 0.5f * FLT_EPSILON) / (1.0f - 3.0f * 0.5f * FLT_EPSILON);
+
+KdTreeRay::KdTreeRay(const float3& origin, const float3& direction)
+	: _origin(origin), _direction(direction)
+{
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		_inverseDirection[axisIndex] = 1.0f / direction[axisIndex];
+		_sign[axisIndex] = (_inverseDirection[axisIndex] < 0.0f) ? 1 : 0;
+	}
+}
+
+bool KdTreeTraversal::intersectBox(float& outTNear, float& outTFar, const float3& bbMin, const float3& bbMax, const KdTreeRay& ray, const float tMin, const float tMax)
+{
+	// Note(jinpark) : (bound - origin) * reciprocal, not bound * reciprocal - origin * reciprocal. the latter cancels
+	//				   catastrophically when the ray starts near the box and the gamma bound no longer holds.
+	const float3* bounds[2] = { &bbMin, &bbMax };
+
+	float tNear = tMin;
+	float tFar = tMax;
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		const uint32 sign = ray._sign[axisIndex];
+		const float t0 = ((*bounds[sign])[axisIndex] - ray._origin[axisIndex]) * ray._inverseDirection[axisIndex];
+		const float t1 = ((*bounds[sign ^ 1])[axisIndex] - ray._origin[axisIndex]) * ray._inverseDirection[axisIndex] * kBoxFarScale;
+
+		// Note(jinpark) : a NaN compares false and keeps the running value, as minss / maxss do.
+		tNear = (tNear < t0) ? t0 : tNear;
+		tFar = (t1 < tFar) ? t1 : tFar;
+	}
+
+	outTNear = tNear;
+	outTFar = tFar;
+	return (tNear <= tFar);
+}
+
+bool KdTreeTraversal::intersectBox(const float3& bbMin, const float3& bbMax, const KdTreeRay& ray, const float tMax)
+{
+	float tNear, tFar;
+	return intersectBox(tNear, tFar, bbMin, bbMax, ray, 0.0f, tMax);
+}
+
+bool KdTreeTraversal::intersectTriangle(float& outT, float& outU, float& outV, const float3& origin, const float3& direction, const float3& position0, const float3& edge0, const float3& edge1)
+{
+	const float3 p = float3::Cross(direction, edge1);
+	const float determinant = float3::Dot(edge0, p);
+	if (fabsf(determinant) < kTriangleEpsilon)
+	{
+		return false;
+	}
+
+	const float inverseDeterminant = 1.0f / determinant;
+
+	const float3 s = origin - position0;
+	const float u = float3::Dot(s, p) * inverseDeterminant;
+	if (u < 0.0f || 1.0f < u)
+	{
+		return false;
+	}
+
+	const float3 q = float3::Cross(s, edge0);
+	const float v = float3::Dot(direction, q) * inverseDeterminant;
+	if (v < 0.0f || 1.0f < (u + v))
+	{
+		return false;
+	}
+
+	outT = float3::Dot(edge1, q) * inverseDeterminant;
+	outU = u;
+	outV = v;
+	return true;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const std::vector<PackedKdNode>& packedNodeArray, const float3& origin, const float3& direction, float tMax)
+{
+	return intersect(outHit, packedNodeArray.data(), static_cast<uint32>(packedNodeArray.size()), origin, direction, tMax);
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const PackedKdNode* packedNodes, const uint32 packedNodeCount, const float3& origin, const float3& direction, float tMax)
+{
+	const uint32 primitiveCount = getPrimitiveCount(packedNodeCount);
+	if (0 == primitiveCount)
+	{
+		return false;
+	}
+
+	// Note(jinpark) : leaf node stores (primitiveIndex + kdNodeCount * 2), see KdTree::build
+	const uint32 primitiveOffset = packedNodeCount - primitiveCount;
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (0xffffffff != nodeIndex)
+	{
+		const PackedKdNode& packedNode0 = packedNodes[nodeIndex * 2 + 0];
+		const PackedKdNode& packedNode1 = packedNodes[nodeIndex * 2 + 1];
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+		if (true == isLeafNode)
+		{
+			const float3& position0 = packedNodes[packedNode0._parameter1]._parameter0;
+
+			float t, u, v;
+			if (intersectTriangle(t, u, v, origin, direction, position0, packedNode0._parameter0, packedNode1._parameter0) && (0.0f < t) && (t < tMax))
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = packedNode0._parameter1 - primitiveOffset;
+				isHit = true;
+			}
+
+			nodeIndex = packedNode1._parameter1;
+		}
+		else
+		{
+			// Note(jinpark) : left child is always next to its parent, so only the miss case jumps.
+			const bool isBoxHit = intersectBox(packedNode0._parameter0, packedNode1._parameter0, ray, tMax);
+			nodeIndex = isBoxHit ? (nodeIndex + 1) : packedNode1._parameter1;
+		}
+	}
+
+	return isHit;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const IndexedKdTree& indexedTree, const float3& origin, const float3& direction, float tMax)
+{
+	const IndexedKdNode* nodes = indexedTree._nodeArray.data();
+	const float3* vertices = indexedTree._vertexArray.data();
+	const uint32 nodeCount = static_cast<uint32>(indexedTree._nodeArray.size());
+
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	// Note(jinpark) : the last skip index is nodeCount, not 0xffffffff, since 0xffffffff marks internal nodes.
+	uint32 nodeIndex = 0;
+	while (nodeIndex < nodeCount)
+	{
+		const IndexedKdNode& node0 = nodes[nodeIndex];
+
+		const bool isLeafNode = (0xffffffff != node0._parameter1);
+		if (true == isLeafNode)
+		{
+			const float3& position0 = vertices[node0._vertexIndices[0]];
+			const float3 edge0 = vertices[node0._vertexIndices[1]] - position0;
+			const float3 edge1 = vertices[node0._vertexIndices[2]] - position0;
+
+			float t, u, v;
+			if (intersectTriangle(t, u, v, origin, direction, position0, edge0, edge1) && (0.0f < t) && (t < tMax))
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = node0._parameter1;
+				isHit = true;
+			}
+
+			nodeIndex += 1;
+		}
+		else
+		{
+			const IndexedKdNode& node1 = nodes[nodeIndex + 1];
+
+			const float3 bbMin = float3(node0._bound[0], node0._bound[1], node0._bound[2]);
+			const float3 bbMax = float3(node1._bound[0], node1._bound[1], node1._bound[2]);
+
+			const bool isBoxHit = intersectBox(bbMin, bbMax, ray, tMax);
+			nodeIndex = isBoxHit ? (nodeIndex + 2) : node1._parameter1;
+		}
+	}
+
+	return isHit;
+}
+
+struct HalfBoundDecoder
+{
+	void decode(float3& out_bbMin, float3& out_bbMax, const HalfKdNode& node, const HalfKdBlock& block) const
+	{
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			out_bbMin[axisIndex] = block._origin[axisIndex] + static_cast<float>(Half(node._bound[axisIndex + 0])) * block._scale;
+			out_bbMax[axisIndex] = block._origin[axisIndex] + static_cast<float>(Half(node._bound[axisIndex + 3])) * block._scale;
+		}
+	}
+};
+
+#if KD_TREE_USE_F16C
+struct F16CHalfBoundDecoder
+{
+	KD_TREE_F16C_TARGET void decode(float3& out_bbMin, float3& out_bbMax, const HalfKdNode& node, const HalfKdBlock& block) const
+	{
+		// Note(jinpark) : one 16 byte load, lanes 0-2 of the first conversion are bbMin, of the second (6 bytes later) are bbMax.
+		const __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&node));
+		const __m128 origin = _mm_loadu_ps(&block._origin.x);
+		const __m128 scale = _mm_set1_ps(block._scale);
+
+		alignas(16) float bbMin[4];
+		alignas(16) float bbMax[4];
+		_mm_store_ps(bbMin, _mm_add_ps(origin, _mm_mul_ps(_mm_cvtph_ps(bits), scale)));
+		_mm_store_ps(bbMax, _mm_add_ps(origin, _mm_mul_ps(_mm_cvtph_ps(_mm_srli_si128(bits, 6)), scale)));
+
+		out_bbMin = float3(bbMin[0], bbMin[1], bbMin[2]);
+		out_bbMax = float3(bbMax[0], bbMax[1], bbMax[2]);
+	}
+};
+
+// Note(jinpark) : the F16C instructions are VEX encoded, so the OS has to save the AVX state as well.
+static bool isF16CAvailable()
+{
+#if defined(_MSC_VER)
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+
+	const bool isXsaveEnabled = (0 != (cpuInfo[2] & (1 << 27)));
+	const bool isAvxSupported = (0 != (cpuInfo[2] & (1 << 28)));
+	const bool isF16CSupported = (0 != (cpuInfo[2] & (1 << 29)));
+	return isXsaveEnabled && isAvxSupported && isF16CSupported && (6 == (_xgetbv(0) & 6));
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#endif
+}
+#endif
+
+template <typename BoundDecoder>
+static bool intersectHalf(KdTreeHit& outHit, const HalfKdTree& halfTree, const float3& origin, const float3& direction, float tMax, const BoundDecoder& boundDecoder)
+{
+	const HalfKdNode* nodes = halfTree._nodeArray.data();
+	const HalfKdBlock* blocks = halfTree._blockArray.data();
+	const uint32 nodeCount = static_cast<uint32>(halfTree._nodeArray.size());
+
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	// Note(jinpark) : the last next node index is nodeCount.
+	uint32 nodeIndex = 0;
+	while (nodeIndex < nodeCount)
+	{
+		const HalfKdNode& node0 = nodes[nodeIndex];
+
+		const bool isLeafNode = (0 != (node0._parameter1 & kHalfKdLeafFlag));
+		if (true == isLeafNode)
+		{
+			const HalfKdNode& node1 = nodes[nodeIndex + 1];
+			const uint32 primitiveIndex = node0._parameter1 & ~kHalfKdLeafFlag;
+
+			const float3 edge0 = float3(node0._edge[0], node0._edge[1], node0._edge[2]);
+			const float3 edge1 = float3(node1._edge[0], node1._edge[1], node1._edge[2]);
+
+			float t, u, v;
+			if (KdTreeTraversal::intersectTriangle(t, u, v, origin, direction, halfTree._positionArray[primitiveIndex], edge0, edge1) && (0.0f < t) && (t < tMax))
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = primitiveIndex;
+				isHit = true;
+			}
+
+			nodeIndex += 2;
+		}
+		else
+		{
+			float3 bbMin, bbMax;
+			boundDecoder.decode(bbMin, bbMax, node0, blocks[nodeIndex / kHalfKdBlockSize]);
+
+			const bool isBoxHit = KdTreeTraversal::intersectBox(bbMin, bbMax, ray, tMax);
+			nodeIndex = isBoxHit ? (nodeIndex + 1) : node0._parameter1;
+		}
+	}
+
+	return isHit;
+}
+
+#if KD_TREE_USE_F16C
+KD_TREE_F16C_TARGET static bool intersectHalfF16C(KdTreeHit& outHit, const HalfKdTree& halfTree, const float3& origin, const float3& direction, float tMax)
+{
+	return intersectHalf(outHit, halfTree, origin, direction, tMax, F16CHalfBoundDecoder());
+}
+#endif
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const HalfKdTree& halfTree, const float3& origin, const float3& direction, float tMax)
+{
+#if KD_TREE_USE_F16C
+	static const bool isF16CEnabled = isF16CAvailable();
+	if (true == isF16CEnabled)
+	{
+		return intersectHalfF16C(outHit, halfTree, origin, direction, tMax);
+	}
+#endif
+
+	return intersectHalf(outHit, halfTree, origin, direction, tMax, HalfBoundDecoder());
+}
+
+static float uint32AsFloat(const uint32 value)
+{
+	float result;
+	memcpy(&result, &value, sizeof(result));
+	return result;
+}
+
+static bool intersectWoopLeaf(float& outT, float& outU, float& outV, const float3& origin, const float3& direction, const PackedKdNode* leafNodes, const float tMax)
+{
+	const uint32 k = leafNodes[0]._parameter1 >> 30;
+	const uint32 a = (k + 1) % 3;
+	const uint32 b = (k + 2) % 3;
+
+	const float3& row2 = leafNodes[2]._parameter0;
+	const float originZ = row2.z + origin[k] + row2.x * origin[a] + row2.y * origin[b];
+	const float directionZ = direction[k] + row2.x * direction[a] + row2.y * direction[b];
+
+	const float t = -originZ / directionZ;
+	if (false == ((0.0f < t) && (t < tMax)))
+	{
+		return false;
+	}
+
+	const float3& row0 = leafNodes[0]._parameter0;
+	const float u = uint32AsFloat(leafNodes[1]._parameter1) + float3::Dot(row0, origin) + t * float3::Dot(row0, direction);
+	if (u < 0.0f || 1.0f < u)
+	{
+		return false;
+	}
+
+	const float3& row1 = leafNodes[1]._parameter0;
+	const float v = uint32AsFloat(leafNodes[2]._parameter1) + float3::Dot(row1, origin) + t * float3::Dot(row1, direction);
+	if (v < 0.0f || 1.0f < (u + v))
+	{
+		return false;
+	}
+
+	outT = t;
+	outU = u;
+	outV = v;
+	return true;
+}
+
+// Note(jinpark) : Woop, Benthin, Wald 2013, "Watertight Ray/Triangle Intersection". the ray is sheared to +z,
+//				   edge functions are evaluated on the exact vertices so a ray can not pass between two triangles sharing an edge.
+struct WatertightRay
+{
+	uint32 _kx, _ky, _kz;
+	float _shearX, _shearY, _shearZ;
+
+	WatertightRay(const float3& direction)
+	{
+		_kz = 0;
+		if (fabsf(direction.y) > fabsf(direction[_kz])) _kz = 1;
+		if (fabsf(direction.z) > fabsf(direction[_kz])) _kz = 2;
+		_kx = (_kz + 1) % 3;
+		_ky = (_kx + 1) % 3;
+		if (direction[_kz] < 0.0f)
+		{
+			std::swap(_kx, _ky);
+		}
+
+		_shearX = direction[_kx] / direction[_kz];
+		_shearY = direction[_ky] / direction[_kz];
+		_shearZ = 1.0f / direction[_kz];
+	}
+};
+
+static bool intersectWatertightLeaf(float& outT, float& outU, float& outV, const float3& origin, const WatertightRay& ray, const PackedKdNode* leafNodes, const float tMax)
+{
+	const float3 a = leafNodes[0]._parameter0 - origin;
+	const float3 b = leafNodes[1]._parameter0 - origin;
+	const float3 c = leafNodes[2]._parameter0 - origin;
+
+	const float ax = a[ray._kx] - ray._shearX * a[ray._kz];
+	const float ay = a[ray._ky] - ray._shearY * a[ray._kz];
+	const float bx = b[ray._kx] - ray._shearX * b[ray._kz];
+	const float by = b[ray._ky] - ray._shearY * b[ray._kz];
+	const float cx = c[ray._kx] - ray._shearX * c[ray._kz];
+	const float cy = c[ray._ky] - ray._shearY * c[ray._kz];
+
+	float u = cx * by - cy * bx;
+	float v = ax * cy - ay * cx;
+	float w = bx * ay - by * ax;
+
+	// Note(jinpark) : an edge function of exactly 0 is ambiguous in float, decide it in double.
+	if ((0.0f == u) || (0.0f == v) || (0.0f == w))
+	{
+		u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+		v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+		w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+	}
+
+	if (((u < 0.0f) || (v < 0.0f) || (w < 0.0f)) && ((0.0f < u) || (0.0f < v) || (0.0f < w)))
+	{
+		return false;
+	}
+
+	const float determinant = u + v + w;
+	if (0.0f == determinant)
+	{
+		return false;
+	}
+
+	const float az = ray._shearZ * a[ray._kz];
+	const float bz = ray._shearZ * b[ray._kz];
+	const float cz = ray._shearZ * c[ray._kz];
+	const float scaledT = u * az + v * bz + w * cz;
+
+	const float inverseDeterminant = 1.0f / determinant;
+	const float t = scaledT * inverseDeterminant;
+	if (false == ((0.0f < t) && (t < tMax)))
+	{
+		return false;
+	}
+
+	// Note(jinpark) : u, v follow intersectTriangle, weights of position1 and position2.
+	outT = t;
+	outU = v * inverseDeterminant;
+	outV = w * inverseDeterminant;
+	return true;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const LeafKdTree& leafTree, const float3& origin, const float3& direction, float tMax)
+{
+	const PackedKdNode* nodes = leafTree._nodeArray.data();
+	const uint32 nodeCount = static_cast<uint32>(leafTree._nodeArray.size());
+	const bool isWoop = (KdTreeLeafEncoding::Woop == leafTree._leafEncoding);
+
+	const KdTreeRay ray(origin, direction);
+	const WatertightRay watertightRay(direction);
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (nodeIndex < nodeCount)
+	{
+		const PackedKdNode& packedNode0 = nodes[nodeIndex + 0];
+		const PackedKdNode& packedNode1 = nodes[nodeIndex + 1];
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+		if (true == isLeafNode)
+		{
+			float t, u, v;
+			const bool isTriangleHit = (true == isWoop)
+				? intersectWoopLeaf(t, u, v, origin, direction, nodes + nodeIndex, tMax)
+				: intersectWatertightLeaf(t, u, v, origin, watertightRay, nodes + nodeIndex, tMax);
+
+			if (true == isTriangleHit)
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = packedNode0._parameter1 & ((true == isWoop) ? 0x3fffffff : 0xffffffff);
+				isHit = true;
+			}
+
+			nodeIndex += 3;
+		}
+		else
+		{
+			// Note(jinpark) : the box test is conservative for both encodings, so the watertight leaf test is always reached.
+			const bool isBoxHit = intersectBox(packedNode0._parameter0, packedNode1._parameter0, ray, tMax);
+			nodeIndex = isBoxHit ? (nodeIndex + 2) : packedNode1._parameter1;
+		}
+	}
+
+	return isHit;
+}
+
+// Note(jinpark) : Moller-Trumbore on both triangles of a quad leaf at once, lane 0 is (v0, v1, v2) and lane 1 is (v0, v2, v3).
+//				   lanes 2 and 3 repeat them and are dropped, each lane does the same arithmetic as intersectTriangle.
+static bool intersectQuadLeaf(float& outT, float& outU, float& outV, uint32& outTriangleIndex, const float3& origin, const float3& direction, const PackedKdNode* leafNodes, const float tMax)
+{
+	const __m128 edgeX = _mm_loadu_ps(&leafNodes[0]._parameter0.x);
+	const __m128 edgeY = _mm_loadu_ps(&leafNodes[1]._parameter0.x);
+	const __m128 edgeZ = _mm_loadu_ps(&leafNodes[2]._parameter0.x);
+
+	// Note(jinpark) : w of the loads is an index, never used as a float.
+	const __m128 edge0X = _mm_shuffle_ps(edgeX, edgeX, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m128 edge0Y = _mm_shuffle_ps(edgeY, edgeY, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m128 edge0Z = _mm_shuffle_ps(edgeZ, edgeZ, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m128 edge1X = _mm_shuffle_ps(edgeX, edgeX, _MM_SHUFFLE(2, 1, 2, 1));
+	const __m128 edge1Y = _mm_shuffle_ps(edgeY, edgeY, _MM_SHUFFLE(2, 1, 2, 1));
+	const __m128 edge1Z = _mm_shuffle_ps(edgeZ, edgeZ, _MM_SHUFFLE(2, 1, 2, 1));
+
+	const __m128 directionX = _mm_set1_ps(direction.x);
+	const __m128 directionY = _mm_set1_ps(direction.y);
+	const __m128 directionZ = _mm_set1_ps(direction.z);
+
+	const __m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge1Z), _mm_mul_ps(edge1Y, directionZ));
+	const __m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge1X), _mm_mul_ps(edge1Z, directionX));
+	const __m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge1Y), _mm_mul_ps(edge1X, directionY));
+
+	const __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge0X, pX), _mm_mul_ps(edge0Y, pY)), _mm_mul_ps(edge0Z, pZ));
+	const __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+	const float3 s = origin - leafNodes[3]._parameter0;
+	const __m128 sX = _mm_set1_ps(s.x);
+	const __m128 sY = _mm_set1_ps(s.y);
+	const __m128 sZ = _mm_set1_ps(s.z);
+
+	const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, pX), _mm_mul_ps(sY, pY)), _mm_mul_ps(sZ, pZ)), inverseDeterminant);
+
+	const __m128 qX = _mm_sub_ps(_mm_mul_ps(sY, edge0Z), _mm_mul_ps(edge0Y, sZ));
+	const __m128 qY = _mm_sub_ps(_mm_mul_ps(sZ, edge0X), _mm_mul_ps(edge0Z, sX));
+	const __m128 qZ = _mm_sub_ps(_mm_mul_ps(sX, edge0Y), _mm_mul_ps(edge0X, sY));
+
+	const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverseDeterminant);
+	const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, qX), _mm_mul_ps(edge1Y, qY)), _mm_mul_ps(edge1Z, qZ)), inverseDeterminant);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128 hitMask = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), determinant), _mm_set1_ps(kTriangleEpsilon));
+	hitMask = _mm_and_ps(hitMask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+	hitMask = _mm_and_ps(hitMask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+	hitMask = _mm_and_ps(hitMask, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+
+	const int laneMask = (0xffffffff == leafNodes[1]._parameter1) ? 0x1 : 0x3;
+	const int hitLaneMask = _mm_movemask_ps(hitMask) & laneMask;
+	if (0 == hitLaneMask)
+	{
+		return false;
+	}
+
+	float tArray[4], uArray[4], vArray[4];
+	_mm_storeu_ps(tArray, t);
+	_mm_storeu_ps(uArray, u);
+	_mm_storeu_ps(vArray, v);
+
+	const uint32 laneIndex = ((0x2 == hitLaneMask) || ((0x3 == hitLaneMask) && (tArray[1] < tArray[0]))) ? 1 : 0;
+
+	// Note(jinpark) : barycentrics of the lane corners, reported in the source corner order.
+	const float weights[] = { 1.0f - uArray[laneIndex] - vArray[laneIndex], uArray[laneIndex], vArray[laneIndex] };
+	const uint32 cornerCode = leafNodes[2]._parameter1 >> (laneIndex * 4);
+
+	outT = tArray[laneIndex];
+	outU = weights[cornerCode & 0x3];
+	outV = weights[(cornerCode >> 2) & 0x3];
+	outTriangleIndex = laneIndex;
+	return true;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const QuadKdTree& quadTree, const float3& origin, const float3& direction, float tMax)
+{
+	const PackedKdNode* nodes = quadTree._nodeArray.data();
+	const uint32 nodeCount = static_cast<uint32>(quadTree._nodeArray.size());
+
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (nodeIndex < nodeCount)
+	{
+		const PackedKdNode& packedNode0 = nodes[nodeIndex + 0];
+		const PackedKdNode& packedNode1 = nodes[nodeIndex + 1];
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+		if (true == isLeafNode)
+		{
+			float t, u, v;
+			uint32 triangleIndex;
+			if (true == intersectQuadLeaf(t, u, v, triangleIndex, origin, direction, nodes + nodeIndex, tMax))
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = nodes[nodeIndex + triangleIndex]._parameter1;
+				isHit = true;
+			}
+
+			nodeIndex += 4;
+		}
+		else
+		{
+			const bool isBoxHit = intersectBox(packedNode0._parameter0, packedNode1._parameter0, ray, tMax);
+			nodeIndex = isBoxHit ? (nodeIndex + 2) : packedNode1._parameter1;
+		}
+	}
+
+	return isHit;
+}
+
+struct NullCacheModel
+{
+	void access(const void*, const uint32) {}
+};
+
+template <typename CacheModel>
+static bool intersectOrdered(KdTreeHit& outHit, const OrderedKdTree& orderedTree, const float3& origin, const float3& direction, float tMax, CacheModel& cacheModel)
+{
+	const PackedKdNode* nodes = orderedTree._nodeArray.data();
+	const uint32 primitiveOffset = orderedTree._nodeCount * 2;
+	if (0 == primitiveOffset)
+	{
+		return false;
+	}
+
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (0xffffffff != nodeIndex)
+	{
+		const PackedKdNode& packedNode0 = nodes[nodeIndex * 2 + 0];
+		const PackedKdNode& packedNode1 = nodes[nodeIndex * 2 + 1];
+		cacheModel.access(&packedNode0, sizeof(PackedKdNode) * 2);
+
+		const bool isLeafNode = (0 == (packedNode0._parameter1 & kOrderedKdInternalFlag));
+		if (true == isLeafNode)
+		{
+			const PackedKdNode& position0 = nodes[primitiveOffset + packedNode0._parameter1];
+			cacheModel.access(&position0, sizeof(PackedKdNode));
+
+			float t, u, v;
+			if (KdTreeTraversal::intersectTriangle(t, u, v, origin, direction, position0._parameter0, packedNode0._parameter0, packedNode1._parameter0) && (0.0f < t) && (t < tMax))
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = packedNode0._parameter1;
+				isHit = true;
+			}
+
+			nodeIndex = packedNode1._parameter1;
+		}
+		else
+		{
+			const bool isBoxHit = KdTreeTraversal::intersectBox(packedNode0._parameter0, packedNode1._parameter0, ray, tMax);
+			nodeIndex = isBoxHit ? (packedNode0._parameter1 & ~kOrderedKdInternalFlag) : packedNode1._parameter1;
+		}
+	}
+
+	return isHit;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const OrderedKdTree& orderedTree, const float3& origin, const float3& direction, float tMax)
+{
+	NullCacheModel cacheModel;
+	return intersectOrdered(outHit, orderedTree, origin, direction, tMax, cacheModel);
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const OrderedKdTree& orderedTree, const float3& origin, const float3& direction, float tMax, KdTreeCacheModel& cacheModel)
+{
+	return intersectOrdered(outHit, orderedTree, origin, direction, tMax, cacheModel);
+}
+
+// Note(jinpark) : segmentIntersect(outSegmentHit, outPrimitiveIndex, segmentIndex, tMax) tests one segment.
+template <typename SegmentIntersect>
+static bool intersectSegmented(KdTreeHit& outHit, uint64& outPrimitiveIndex, const PackedKdNode* topNodes, const float3& origin, const float3& direction, float tMax, const SegmentIntersect& segmentIntersect)
+{
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (0xffffffff != nodeIndex)
+	{
+		const PackedKdNode& packedNode0 = topNodes[nodeIndex * 2 + 0];
+		const PackedKdNode& packedNode1 = topNodes[nodeIndex * 2 + 1];
+
+		if (false == KdTreeTraversal::intersectBox(packedNode0._parameter0, packedNode1._parameter0, ray, tMax))
+		{
+			nodeIndex = packedNode1._parameter1;
+			continue;
+		}
+
+		const bool isSegmentNode = (0xffffffff != packedNode0._parameter1);
+		if (false == isSegmentNode)
+		{
+			nodeIndex = nodeIndex + 1;
+			continue;
+		}
+
+		KdTreeHit segmentHit;
+		uint64 primitiveIndex;
+		if (true == segmentIntersect(segmentHit, primitiveIndex, packedNode0._parameter1, tMax))
+		{
+			tMax = segmentHit._t;
+
+			outHit = segmentHit;
+			outPrimitiveIndex = primitiveIndex;
+			isHit = true;
+		}
+
+		nodeIndex = packedNode1._parameter1;
+	}
+
+	return isHit;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, uint64& outPrimitiveIndex, const SegmentedKdTree& segmentedTree, const float3& origin, const float3& direction, float tMax)
+{
+	if (true == segmentedTree._topNodeArray.empty())
+	{
+		return false;
+	}
+
+	auto segmentIntersect = [&segmentedTree, &origin, &direction](KdTreeHit& outSegmentHit, uint64& outSegmentPrimitiveIndex, const uint32 segmentIndex, const float segmentTMax)
+	{
+		const KdTreeSegment& segment = segmentedTree._segmentArray[segmentIndex];
+		if (false == intersect(outSegmentHit, segment._packedNodeArray, origin, direction, segmentTMax))
+		{
+			return false;
+		}
+
+		outSegmentPrimitiveIndex = segmentedTree._primitiveIndexArray[segment._primitiveBase + outSegmentHit._primitiveIndex];
+		return true;
+	};
+
+	return intersectSegmented(outHit, outPrimitiveIndex, segmentedTree._topNodeArray.data(), origin, direction, tMax, segmentIntersect);
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, uint64& outPrimitiveIndex, const KdTreeFile& streamFile, const float3& origin, const float3& direction, float tMax)
+{
+	const PackedKdNode* packedNodes = streamFile.getPackedNodes();
+	const uint32 packedNodeCount = streamFile.getPackedNodeCount();
+	if (0 == packedNodeCount)
+	{
+		return false;
+	}
+
+	if (false == streamFile.isSegmented())
+	{
+		if (false == intersect(outHit, packedNodes, packedNodeCount, origin, direction, tMax))
+		{
+			return false;
+		}
+
+		const uint32 primitiveOffset = packedNodeCount - getPrimitiveCount(packedNodeCount);
+		outPrimitiveIndex = packedNodes[primitiveOffset + outHit._primitiveIndex]._parameter1;
+		return true;
+	}
+
+	const KdTreeFileSegment* segments = streamFile.getSegments();
+	const uint64* primitiveIndices = streamFile.getPrimitiveIndices();
+
+	auto segmentIntersect = [&streamFile, segments, primitiveIndices, &origin, &direction](KdTreeHit& outSegmentHit, uint64& outSegmentPrimitiveIndex, const uint32 segmentIndex, const float segmentTMax)
+	{
+		const KdTreeFileSegment& segment = segments[segmentIndex];
+		if (false == intersect(outSegmentHit, streamFile.getSegmentPackedNodes(segmentIndex), segment._packedNodeCount, origin, direction, segmentTMax))
+		{
+			return false;
+		}
+
+		outSegmentPrimitiveIndex = primitiveIndices[segment._primitiveBase + outSegmentHit._primitiveIndex];
+		return true;
+	};
+
+	return intersectSegmented(outHit, outPrimitiveIndex, packedNodes, origin, direction, tMax, segmentIntersect);
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const MultiMeshKdTree& multiMeshTree, const float3& origin, const float3& direction, float tMax)
+{
+	const uint32 packedNodeCount = static_cast<uint32>(multiMeshTree._packedNodeArray.size());
+	if (false == intersect(outHit, multiMeshTree._packedNodeArray.data(), packedNodeCount, origin, direction, tMax))
+	{
+		return false;
+	}
+
+	// Note(jinpark) : the position0 entry was just read by the hit leaf, so the source index is a cached load.
+	//				   it is the source index also after reorderPrimitives, where the hit index is the leaf order one.
+	const uint32 primitiveOffset = packedNodeCount - getPrimitiveCount(packedNodeCount);
+	const uint32 sourcePrimitiveIndex = multiMeshTree._packedNodeArray[primitiveOffset + outHit._primitiveIndex]._parameter1;
+	const uint32 geometryIndex = multiMeshTree._geometryIndexArray[sourcePrimitiveIndex];
+
+	outHit._geometryIndex = geometryIndex;
+	outHit._primitiveIndex = sourcePrimitiveIndex - multiMeshTree._primitiveBaseArray[geometryIndex];
+	return true;
+}
+
+// Note(jinpark) : entry point only, a ray starting inside the sphere does not hit it.
+static bool intersectSphere(float& outT, const float3& center, const float radius, const float3& origin, const float3& direction)
+{
+	const float3 oc = origin - center;
+	const float a = float3::Dot(direction, direction);
+	const float b = float3::Dot(oc, direction);
+	const float c = float3::Dot(oc, oc) - radius * radius;
+
+	const float discriminant = b * b - a * c;
+	if (discriminant < 0.0f)
+	{
+		return false;
+	}
+
+	outT = (-b - sqrtf(discriminant)) / a;
+	return true;
+}
+
+// Note(jinpark) : entry point only, the nearest of the side cylinder and the two cap spheres.
+static bool intersectCapsule(float& outT, const float3& position0, const float3& position1, const float radius, const float3& origin, const float3& direction)
+{
+	const float directionLength = direction.Length();
+	const float3 rayDirection = direction * (1.0f / directionLength);
+
+	const float3 ba = position1 - position0;
+	const float3 oa = origin - position0;
+
+	const float baba = float3::Dot(ba, ba);
+	const float bard = float3::Dot(ba, rayDirection);
+	const float baoa = float3::Dot(ba, oa);
+	const float rdoa = float3::Dot(rayDirection, oa);
+	const float oaoa = float3::Dot(oa, oa);
+
+	bool isHit = false;
+	float tNearest = FLT_MAX;
+
+	const float a = baba - bard * bard;
+	if (0.0f < a)
+	{
+		const float b = baba * rdoa - baoa * bard;
+		const float c = baba * oaoa - baoa * baoa - radius * radius * baba;
+		const float discriminant = b * b - a * c;
+		if (0.0f <= discriminant)
+		{
+			const float t = (-b - sqrtf(discriminant)) / a;
+			const float y = baoa + t * bard;
+			if ((0.0f < y) && (y < baba))
+			{
+				tNearest = t;
+				isHit = true;
+			}
+		}
+	}
+
+	float t;
+	if ((true == intersectSphere(t, position0, radius, origin, rayDirection)) && (t < tNearest))
+	{
+		tNearest = t;
+		isHit = true;
+	}
+	if ((true == intersectSphere(t, position1, radius, origin, rayDirection)) && (t < tNearest))
+	{
+		tNearest = t;
+		isHit = true;
+	}
+
+	outT = tNearest / directionLength;
+	return isHit;
+}
+
+template <typename ShapeIntersect>
+static bool intersectShapes(KdTreeHit& outHit, const ShapeKdTree& shapeTree, const float3& origin, const float3& direction, float tMax, const ShapeIntersect& shapeIntersect)
+{
+	if (true == shapeTree._nodeArray.empty())
+	{
+		return false;
+	}
+
+	const PackedKdNode* nodes = shapeTree._nodeArray.data();
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (0xffffffff != nodeIndex)
+	{
+		const PackedKdNode& packedNode0 = nodes[nodeIndex * 2 + 0];
+		const PackedKdNode& packedNode1 = nodes[nodeIndex * 2 + 1];
+
+		const bool isLeafNode = (0xffffffff != packedNode0._parameter1);
+		if (true == isLeafNode)
+		{
+			// Note(jinpark) : leaf box is the primitive bound, it rejects most rays before the shape is read.
+			float t, tFar;
+			if (true == KdTreeTraversal::intersectBox(t, tFar, packedNode0._parameter0, packedNode1._parameter0, ray, 0.0f, tMax))
+			{
+				const KdShape& shape = shapeTree._shapeArray[packedNode0._parameter1];
+				if (shapeIntersect(t, shape, tMax) && (0.0f < t) && (t < tMax))
+				{
+					tMax = t;
+
+					outHit._t = t;
+					outHit._u = 0.0f;
+					outHit._v = 0.0f;
+					outHit._primitiveIndex = shape._primitiveIndex;
+					isHit = true;
+				}
+			}
+
+			nodeIndex = packedNode1._parameter1;
+		}
+		else
+		{
+			const bool isBoxHit = KdTreeTraversal::intersectBox(packedNode0._parameter0, packedNode1._parameter0, ray, tMax);
+			nodeIndex = isBoxHit ? (nodeIndex + 1) : packedNode1._parameter1;
+		}
+	}
+
+	return isHit;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const ShapeKdTree& shapeTree, const float3& origin, const float3& direction, float tMax)
+{
+	// Note(jinpark) : the shape type is per tree, so the switch is outside the walk.
+	switch (shapeTree._shapeType)
+	{
+	case KdShapeType::Sphere:
+		return intersectShapes(outHit, shapeTree, origin, direction, tMax, [&origin, &direction](float& inOutT, const KdShape& shape, const float)
+			{
+				return intersectSphere(inOutT, shape._position0, shape._radius, origin, direction);
+			});
+	case KdShapeType::Capsule:
+		return intersectShapes(outHit, shapeTree, origin, direction, tMax, [&origin, &direction](float& inOutT, const KdShape& shape, const float)
+			{
+				return intersectCapsule(inOutT, shape._position0, shape._position1, shape._radius, origin, direction);
+			});
+	default:
+		// Note(jinpark) : the box entry point found by the leaf test is the hit.
+		return intersectShapes(outHit, shapeTree, origin, direction, tMax, [](float&, const KdShape&, const float)
+			{
+				return true;
+			});
+	}
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const ShapeKdTree& shapeTree, const float3& origin, const float3& direction, float tMax, const KdShapeIntersector& shapeIntersector)
+{
+	return intersectShapes(outHit, shapeTree, origin, direction, tMax, [&origin, &direction, &shapeIntersector](float& inOutT, const KdShape& shape, const float currentTMax)
+		{
+			return shapeIntersector(inOutT, shape, origin, direction, currentTMax);
+		});
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const SpatialKdTree& spatialTree, const float3& origin, const float3& direction, float tMax)
+{
+	if (true == spatialTree._nodeArray.empty())
+	{
+		return false;
+	}
+
+	const KdTreeRay ray(origin, direction);
+
+	float tEntry, tExit;
+	if (false == intersectBox(tEntry, tExit, spatialTree._bbMin, spatialTree._bbMax, ray, 0.0f, tMax))
+	{
+		return false;
+	}
+
+	const SpatialKdNode* nodes = spatialTree._nodeArray.data();
+	const float3* triangles = spatialTree._triangleArray.data();
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (0xffffffff != nodeIndex)
+	{
+		// Note(jinpark) : the entry point is on the face the rope was taken through, a tie goes the way the ray moves.
+		const float3 entryPosition = origin + direction * tEntry;
+		while (false == nodes[nodeIndex].isLeaf())
+		{
+			const SpatialKdNode& node = nodes[nodeIndex];
+			const uint32 axis = node.getAxis();
+
+			const bool isLeft = (entryPosition[axis] < node._split) || ((entryPosition[axis] == node._split) && (direction[axis] < 0.0f));
+			nodeIndex = isLeft ? (nodeIndex + 1) : node.getIndex();
+		}
+
+		const SpatialKdLeaf& leaf = spatialTree._leafArray[nodes[nodeIndex].getIndex()];
+		for (uint32 referenceIndex = 0; referenceIndex < leaf._referenceCount; ++referenceIndex)
+		{
+			const uint32 triangleIndex = spatialTree._referenceArray[leaf._referenceBegin + referenceIndex];
+			const float3* triangle = &triangles[triangleIndex * 3];
+
+			float t, u, v;
+			if (intersectTriangle(t, u, v, origin, direction, triangle[0], triangle[1], triangle[2]) && (0.0f < t) && (t < tMax))
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = triangleIndex;
+				isHit = true;
+			}
+		}
+
+		float tLeafExit = FLT_MAX;
+		uint32 exitFaceIndex = 0xffffffff;
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			if (0.0f == direction[axisIndex])
+			{
+				continue;
+			}
+
+			const bool isMaxFace = (0.0f < direction[axisIndex]);
+			const float t = ((isMaxFace ? leaf._bbMax[axisIndex] : leaf._bbMin[axisIndex]) - origin[axisIndex]) * ray._inverseDirection[axisIndex];
+			if (t < tLeafExit)
+			{
+				tLeafExit = t;
+				exitFaceIndex = axisIndex * 2 + (isMaxFace ? 1 : 0);
+			}
+		}
+
+		// Note(jinpark) : a straddling triangle can be hit past this leaf, the hit is kept but only final once
+		//				   the leaves walked so far cover it.
+		if ((tMax <= tLeafExit) || (0xffffffff == exitFaceIndex))
+		{
+			break;
+		}
+
+		tEntry = std::max(tEntry, tLeafExit);
+		nodeIndex = leaf._ropeArray[exitFaceIndex];
+	}
+
+	return isHit;
+}
+
+// Note(jinpark) : Amanatides-Woo over [tEntry, tExit], which the caller has clipped to the level box.
+//				   visitCell(cellIndex, tCellExit) returns true to stop the walk.
+template <typename VisitCell>
+static void walkGridLevel(const GridLevel& level, const KdTreeRay& ray, float tEntry, const float tExit, VisitCell& visitCell)
+{
+	const float3 entryPosition = ray._origin + ray._direction * tEntry;
+
+	int cell[3], step[3], cellEnd[3];
+	float tNext[3], tDelta[3];
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		const float coordinate = (entryPosition[axisIndex] - level._bbMin[axisIndex]) * level._inverseCellSize[axisIndex];
+		cell[axisIndex] = std::min(std::max(static_cast<int>(coordinate), 0), static_cast<int>(level._resolution[axisIndex]) - 1);
+
+		if (0.0f < ray._direction[axisIndex])
+		{
+			step[axisIndex] = 1;
+			cellEnd[axisIndex] = static_cast<int>(level._resolution[axisIndex]);
+			tNext[axisIndex] = (level._bbMin[axisIndex] + (cell[axisIndex] + 1) * level._cellSize[axisIndex] - ray._origin[axisIndex]) * ray._inverseDirection[axisIndex];
+			tDelta[axisIndex] = level._cellSize[axisIndex] * ray._inverseDirection[axisIndex];
+		}
+		else if (ray._direction[axisIndex] < 0.0f)
+		{
+			step[axisIndex] = -1;
+			cellEnd[axisIndex] = -1;
+			tNext[axisIndex] = (level._bbMin[axisIndex] + cell[axisIndex] * level._cellSize[axisIndex] - ray._origin[axisIndex]) * ray._inverseDirection[axisIndex];
+			tDelta[axisIndex] = -level._cellSize[axisIndex] * ray._inverseDirection[axisIndex];
+		}
+		else
+		{
+			step[axisIndex] = 0;
+			cellEnd[axisIndex] = -1;
+			tNext[axisIndex] = FLT_MAX;
+			tDelta[axisIndex] = FLT_MAX;
+		}
+	}
+
+	for (;;)
+	{
+		uint32 axis = (tNext[1] < tNext[0]) ? 1 : 0;
+		axis = (tNext[2] < tNext[axis]) ? 2 : axis;
+
+		const float tCellExit = std::min(tNext[axis], tExit);
+		const uint32 cellIndex = (cell[2] * level._resolution[1] + cell[1]) * level._resolution[0] + cell[0];
+		if ((true == visitCell(cellIndex, tEntry, tCellExit)) || (tExit <= tCellExit))
+		{
+			return;
+		}
+
+		cell[axis] += step[axis];
+		if (cellEnd[axis] == cell[axis])
+		{
+			return;
+		}
+
+		tEntry = tNext[axis];
+		tNext[axis] += tDelta[axis];
+	}
+}
+
+// Note(jinpark) : a triangle can span cells and be hit past this one, the hit is kept but only final once the walked cells cover it.
+static bool intersectGridCell(KdTreeHit& outHit, float& inOutTMax, const GridLevel& level, const float3* triangles, const uint32 cellIndex, const float3& origin, const float3& direction)
+{
+	bool isHit = false;
+
+	const uint32 referenceEnd = level._cellBeginArray[cellIndex + 1];
+	for (uint32 referenceIndex = level._cellBeginArray[cellIndex]; referenceIndex < referenceEnd; ++referenceIndex)
+	{
+		const uint32 triangleIndex = level._referenceArray[referenceIndex];
+		const float3* triangle = &triangles[triangleIndex * 3];
+
+		float t, u, v;
+		if (KdTreeTraversal::intersectTriangle(t, u, v, origin, direction, triangle[0], triangle[1], triangle[2]) && (0.0f < t) && (t < inOutTMax))
+		{
+			inOutTMax = t;
+
+			outHit._t = t;
+			outHit._u = u;
+			outHit._v = v;
+			outHit._primitiveIndex = triangleIndex;
+			isHit = true;
+		}
+	}
+
+	return isHit;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const UniformGrid& grid, const float3& origin, const float3& direction, float tMax)
+{
+	const GridLevel& level = grid._level;
+	if (0 == level.getCellCount())
+	{
+		return false;
+	}
+
+	const KdTreeRay ray(origin, direction);
+
+	float tEntry, tExit;
+	if (false == intersectBox(tEntry, tExit, level._bbMin, level._bbMax, ray, 0.0f, tMax))
+	{
+		return false;
+	}
+
+	bool isHit = false;
+	auto visitCell = [&](const uint32 cellIndex, const float, const float tCellExit)
+	{
+		isHit |= intersectGridCell(outHit, tMax, level, grid._triangleArray.data(), cellIndex, origin, direction);
+		return (tMax <= tCellExit);
+	};
+	walkGridLevel(level, ray, tEntry, tExit, visitCell);
+
+	return isHit;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const HierarchicalGrid& grid, const float3& origin, const float3& direction, float tMax)
+{
+	const GridLevel& topLevel = grid._topLevel;
+	if (0 == topLevel.getCellCount())
+	{
+		return false;
+	}
+
+	const KdTreeRay ray(origin, direction);
+
+	float tEntry, tExit;
+	if (false == intersectBox(tEntry, tExit, topLevel._bbMin, topLevel._bbMax, ray, 0.0f, tMax))
+	{
+		return false;
+	}
+
+	bool isHit = false;
+	auto visitSubCell = [&](const GridLevel& subLevel, const uint32 cellIndex, const float tCellExit)
+	{
+		isHit |= intersectGridCell(outHit, tMax, subLevel, grid._triangleArray.data(), cellIndex, origin, direction);
+		return (tMax <= tCellExit);
+	};
+	auto visitTopCell = [&](const uint32 cellIndex, const float tCellEntry, const float tCellExit)
+	{
+		const uint32 subLevelIndex = grid._subLevelIndexArray[cellIndex];
+		if (0xffffffff == subLevelIndex)
+		{
+			isHit |= intersectGridCell(outHit, tMax, topLevel, grid._triangleArray.data(), cellIndex, origin, direction);
+		}
+		else
+		{
+			// Note(jinpark) : the sub level box is the top cell, the ray range of the cell is already clipped to it.
+			const GridLevel& subLevel = grid._subLevelArray[subLevelIndex];
+			auto visitCell = [&subLevel, &visitSubCell](const uint32 subCellIndex, const float, const float tSubCellExit)
+			{
+				return visitSubCell(subLevel, subCellIndex, tSubCellExit);
+			};
+			walkGridLevel(subLevel, ray, tCellEntry, tCellExit, visitCell);
+		}
+		return (tMax <= tCellExit);
+	};
+	walkGridLevel(topLevel, ray, tEntry, tExit, visitTopCell);
+
+	return isHit;
+}
+
+bool KdTreeTraversal::intersect(KdTreeHit& outHit, const MotionKdTree& motionTree, const float3& origin, const float3& direction, float tMax, const float time)
+{
+	if (true == motionTree._nodeArray.empty())
+	{
+		return false;
+	}
+
+	const PackedKdNode* nodes = motionTree._nodeArray.data();
+	const KdTreeRay ray(origin, direction);
+	const float time0 = 1.0f - time;
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (0xffffffff != nodeIndex)
+	{
+		const PackedKdNode* packedNodes = &nodes[nodeIndex * 4];
+
+		// Note(jinpark) : the lerp of the keyframe bounds bounds the lerped triangles, so it is exact enough to cull with.
+		const float3 parameter0 = packedNodes[0]._parameter0 * time0 + packedNodes[2]._parameter0 * time;
+		const float3 parameter1 = packedNodes[1]._parameter0 * time0 + packedNodes[3]._parameter0 * time;
+
+		const bool isLeafNode = (0xffffffff != packedNodes[0]._parameter1);
+		if (true == isLeafNode)
+		{
+			const uint32 primitiveIndex = packedNodes[0]._parameter1;
+			const float3 position0 = motionTree._positionArray[primitiveIndex * 2 + 0] * time0 + motionTree._positionArray[primitiveIndex * 2 + 1] * time;
+
+			float t, u, v;
+			if (intersectTriangle(t, u, v, origin, direction, position0, parameter0, parameter1) && (0.0f < t) && (t < tMax))
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = primitiveIndex;
+				isHit = true;
+			}
+
+			nodeIndex = packedNodes[1]._parameter1;
+		}
+		else
+		{
+			const bool isBoxHit = intersectBox(parameter0, parameter1, ray, tMax);
+			nodeIndex = isBoxHit ? (nodeIndex + 1) : packedNodes[1]._parameter1;
+		}
+	}
+
+	return isHit;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "KdTree.h"
+#include "KdTreeLayout.h"
+#include "SpatialKdTree.h"
+#include "UniformGrid.h"
+
+class KdTreeFile;
+
+struct KdTreeHit
+{
+	float _t = 0.0f;
+	float _u = 0.0f;
+	float _v = 0.0f;
+
+	uint32 _primitiveIndex = 0xffffffff;
+	uint32 _geometryIndex = 0xffffffff;	// Note(jinpark) : only set by MultiMeshKdTree, _primitiveIndex is then local to the geometry
+};
+
+// Note(jinpark) : inOutT comes in as the entry point of the primitive bound, return true with the hit t to accept.
+typedef std::function<bool(float& inOutT, const KdShape& shape, const float3& origin, const float3& direction, const float tMax)> KdShapeIntersector;
+
+// Note(jinpark) : per ray terms of the slab test, made once per traversal instead of at every box.
+//				   a 0 direction gives an infinite reciprocal of the same sign, so _sign is right for -0 and +0 alike.
+struct KdTreeRay
+{
+	float3 _origin;
+	float3 _direction;
+	float3 _inverseDirection;
+	uint32 _sign[3];	// Note(jinpark) : 1 when the reciprocal is negative, bbMax is then the near bound on that axis
+
+	KdTreeRay(const float3& origin, const float3& direction);
+};
+
+class KdTreeTraversal
+{
+public:
+	static bool intersect(KdTreeHit& outHit, const std::vector<PackedKdNode>& packedNodeArray, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const PackedKdNode* packedNodes, const uint32 packedNodeCount, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const IndexedKdTree& indexedTree, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const HalfKdTree& halfTree, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const LeafKdTree& leafTree, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const QuadKdTree& quadTree, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const OrderedKdTree& orderedTree, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const MultiMeshKdTree& multiMeshTree, const float3& origin, const float3& direction, float tMax);
+	// Note(jinpark) : outHit._primitiveIndex is local to the hit segment, outPrimitiveIndex is the source primitive index.
+	static bool intersect(KdTreeHit& outHit, uint64& outPrimitiveIndex, const SegmentedKdTree& segmentedTree, const float3& origin, const float3& direction, float tMax);
+	// Note(jinpark) : KdTreeStreamBuilder output in place, packed or segmented. outPrimitiveIndex is the source triangle index.
+	static bool intersect(KdTreeHit& outHit, uint64& outPrimitiveIndex, const KdTreeFile& streamFile, const float3& origin, const float3& direction, float tMax);
+	// Note(jinpark) : spheres and capsules are tested analytically, box trees report the box entry point. _u and _v are 0.
+	static bool intersect(KdTreeHit& outHit, const ShapeKdTree& shapeTree, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const ShapeKdTree& shapeTree, const float3& origin, const float3& direction, float tMax, const KdShapeIntersector& shapeIntersector);
+	// Note(jinpark) : time in [0, 1] between the keyframes, node bounds and triangle edges are lerped to it.
+	static bool intersect(KdTreeHit& outHit, const MotionKdTree& motionTree, const float3& origin, const float3& direction, float tMax, const float time);
+	// Note(jinpark) : stackless, the leaf is found from the rope target by the entry point and left through its exit face rope.
+	static bool intersect(KdTreeHit& outHit, const SpatialKdTree& spatialTree, const float3& origin, const float3& direction, float tMax);
+	// Note(jinpark) : 3D-DDA, cells in ray order. the hierarchical grid walks a sub level inside each crowded top cell.
+	static bool intersect(KdTreeHit& outHit, const UniformGrid& grid, const float3& origin, const float3& direction, float tMax);
+	static bool intersect(KdTreeHit& outHit, const HierarchicalGrid& grid, const float3& origin, const float3& direction, float tMax);
+	// Note(jinpark) : same walk, every node and position0 read is also fed to cacheModel.
+	static bool intersect(KdTreeHit& outHit, const OrderedKdTree& orderedTree, const float3& origin, const float3& direction, float tMax, KdTreeCacheModel& cacheModel);
+
+	// Note(jinpark) : Ize 2013, "Robust BVH Ray Traversal". branchless, the far distance is pushed out by 1 + 2 * gamma(3) so
+	//				   rounding can not cull a box the ray grazes. a NaN from a ray in a slab plane (0 * inf) keeps the running
+	//				   interval, that slab counts as hit. outTNear, outTFar is the ray interval inside the box clipped to [tMin, tMax].
+	static bool intersectBox(float& outTNear, float& outTFar, const float3& bbMin, const float3& bbMax, const KdTreeRay& ray, const float tMin, const float tMax);
+	static bool intersectBox(const float3& bbMin, const float3& bbMax, const KdTreeRay& ray, const float tMax);
+	static bool intersectTriangle(float& outT, float& outU, float& outV, const float3& origin, const float3& direction, const float3& position0, const float3& edge0, const float3& edge1);
+
+	static uint32 getPrimitiveCount(const uint32 packedNodeCount);
+};
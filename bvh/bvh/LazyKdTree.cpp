@@ -0,0 +1,99 @@
+#include "LazyKdTree.h"
+
+void LazyKdTree::build(const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount, const uint32 stubPrimitiveCount)
+{
+	assert(0 == (indexCount % 3));
+	assert(0 < stubPrimitiveCount);
+
+	_vertices = vertices;
+	_stride = stride;
+	_indices = indices;
+	_expandedStubCount.store(0, std::memory_order_relaxed);
+
+	// Note(jinpark) : 1 step - build primitive node and top levels only
+	KdPrimitiveArray primitiveArray;
+	KdTree::buildPrimitiveArray(primitiveArray, vertices, stride, indices, indexCount);
+	KdTree::buildRangeNodeArray(_nodeArray, primitiveArray, stubPrimitiveCount);
+
+	// Note(jinpark) : 2 step - keep primitive order only, bounds are rebuilt on expansion
+	_primitiveIndexArray = static_cast<std::vector<uint32>&&>(primitiveArray._primitiveIndexArray);
+
+	_stubArray.clear();
+	for (const RangeKdNode& node : _nodeArray)
+	{
+		if (0xffffffff != node._primitiveIndex)
+		{
+			_stubArray.push_back(std::make_unique<Stub>());
+		}
+	}
+}
+
+void LazyKdTree::expandStub(Stub& stub, const RangeKdNode& stubNode) const
+{
+	const uint32 primitiveCount = stubNode._endIndex - stubNode._beginIndex;
+
+	// Note(jinpark) : local primitive i of the subtree is _primitiveIndexArray[_beginIndex + i]
+	std::vector<uint32> localIndexArray(primitiveCount * 3);
+	for (uint32 i = 0; i < primitiveCount; ++i)
+	{
+		const uint32 primitiveIndex = _primitiveIndexArray[stubNode._beginIndex + i];
+
+		localIndexArray[i * 3 + 0] = _indices[primitiveIndex * 3 + 0];
+		localIndexArray[i * 3 + 1] = _indices[primitiveIndex * 3 + 1];
+		localIndexArray[i * 3 + 2] = _indices[primitiveIndex * 3 + 2];
+	}
+
+	KdTree kdTree;
+	kdTree.build(stub._packedNodeArray, _vertices, _stride, localIndexArray.data(), static_cast<uint32>(localIndexArray.size()));
+
+	_expandedStubCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool LazyKdTree::intersect(KdTreeHit& outHit, const float3& origin, const float3& direction, float tMax) const
+{
+	if (true == _nodeArray.empty())
+	{
+		return false;
+	}
+
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (0xffffffff != nodeIndex)
+	{
+		const RangeKdNode& node = _nodeArray[nodeIndex];
+
+		const bool isBoxHit = KdTreeTraversal::intersectBox(node._bbMin, node._bbMax, ray, tMax);
+		if (false == isBoxHit)
+		{
+			nodeIndex = node._nextNodeIndex;
+			continue;
+		}
+
+		const bool isStubNode = (0xffffffff != node._primitiveIndex);
+		if (false == isStubNode)
+		{
+			++nodeIndex;
+			continue;
+		}
+
+		Stub& stub = *_stubArray[node._primitiveIndex];
+		std::call_once(stub._expandFlag, [this, &stub, &node]() { expandStub(stub, node); });
+
+		KdTreeHit stubHit;
+		if (KdTreeTraversal::intersect(stubHit, stub._packedNodeArray, origin, direction, tMax))
+		{
+			tMax = stubHit._t;
+
+			outHit = stubHit;
+			outHit._primitiveIndex = _primitiveIndexArray[node._beginIndex + stubHit._primitiveIndex];
+			isHit = true;
+		}
+
+		nodeIndex = node._nextNodeIndex;
+	}
+
+	return isHit;
+}
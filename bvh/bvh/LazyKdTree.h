@@ -0,0 +1,43 @@
+#pragma once
+
+#include "KdTree.h"
+#include "KdTreeTraversal.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+// Note(jinpark) : only the top levels are built in build(), each leaf is a stub over a primitive range
+//				   which is expanded into a real packed subtree the first time a ray reaches it.
+//				   vertices/indices are referenced, not copied. they must outlive the tree.
+class LazyKdTree
+{
+public:
+	void build(const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount, const uint32 stubPrimitiveCount = 4096);
+
+	// Note(jinpark) : thread safe, each stub is expanded at most once.
+	bool intersect(KdTreeHit& outHit, const float3& origin, const float3& direction, float tMax) const;
+
+	uint32 getStubCount() const { return static_cast<uint32>(_stubArray.size()); }
+	uint32 getExpandedStubCount() const { return _expandedStubCount.load(std::memory_order_relaxed); }
+
+private:
+	struct Stub
+	{
+		std::once_flag _expandFlag;
+		std::vector<PackedKdNode> _packedNodeArray;
+	};
+
+	void expandStub(Stub& stub, const RangeKdNode& stubNode) const;
+
+private:
+	const void* _vertices = nullptr;
+	uint32 _stride = 0;
+	const uint32* _indices = nullptr;
+
+	std::vector<RangeKdNode> _nodeArray;
+	std::vector<uint32> _primitiveIndexArray;
+	std::vector<std::unique_ptr<Stub>> _stubArray;
+
+	mutable std::atomic<uint32> _expandedStubCount{ 0 };
+};
@@ -0,0 +1,341 @@
+#include "PointKdTree.h"
+#include <algorithm>
+#include <float.h>
+
+struct PointKdBuildRange
+{
+	uint32 _begin;
+	uint32 _end;
+	float3 _bbMin;
+	float3 _bbMax;
+};
+
+// Note(jinpark) : median splits keep the depth at log2(pointCount / leafPointCount), one far range per level is pending.
+const uint32 kPointKdStackSize = 64;
+
+struct PointKdSearchRange
+{
+	uint32 _begin;
+	uint32 _end;
+	float _distance2;	// Note(jinpark) : lower bound of the distance to any point of the range
+};
+
+// Note(jinpark) : _offset is the per axis distance from the query to the range box, so _distance2 is the exact box distance.
+struct PointKdPriorityRange
+{
+	uint32 _begin;
+	uint32 _end;
+	float _distance2;
+	float3 _offset;
+};
+
+static float computeDistance2(const float3& lhs, const float3& rhs)
+{
+	const float3 delta = lhs - rhs;
+	return float3::Dot(delta, delta);
+}
+
+static bool compareSearchRange(const PointKdPriorityRange& lhs, const PointKdPriorityRange& rhs)
+{
+	return rhs._distance2 < lhs._distance2;
+}
+
+static bool compareNeighbor(const PointKdNeighbor& lhs, const PointKdNeighbor& rhs)
+{
+	return lhs._distance2 < rhs._distance2;
+}
+
+void PointKdTreeSearch::build(PointKdTree& outPointTree, const void* points, const uint32 stride, const uint32 pointCount, const uint32 leafPointCount)
+{
+	assert(pointCount <= kPointKdMaxPointCount);
+
+	outPointTree._leafPointCount = std::max(leafPointCount, 1u);
+	outPointTree._nodeArray.resize(pointCount);
+	if (0 == pointCount)
+	{
+		return;
+	}
+
+	// Note(jinpark) : 1 step - copy points and bound them, every node starts as a leaf point
+	PointKdNode* nodes = outPointTree._nodeArray.data();
+
+	float3 bbMin = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+	float3 bbMax = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32 pointIndex = 0; pointIndex < pointCount; ++pointIndex)
+	{
+		const float3& position = *reinterpret_cast<const float3*>(static_cast<const uchar*>(points) + static_cast<size_t>(pointIndex) * stride);
+
+		nodes[pointIndex]._position = position;
+		nodes[pointIndex]._parameter = pointIndex | (kPointKdLeafAxis << kPointKdAxisShift);
+
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			bbMin[axisIndex] = std::min(bbMin[axisIndex], position[axisIndex]);
+			bbMax[axisIndex] = std::max(bbMax[axisIndex], position[axisIndex]);
+		}
+	}
+
+	// Note(jinpark) : 2 step - split every range above the leaf size at its median along the longest axis of its box.
+	//				   the box is the parent box cut at the split, so no pass over the points is needed to bound a range.
+	std::vector<PointKdBuildRange> rangeStack;
+	rangeStack.push_back({ 0, pointCount, bbMin, bbMax });
+
+	while (false == rangeStack.empty())
+	{
+		const PointKdBuildRange range = rangeStack.back();
+		rangeStack.pop_back();
+
+		if (range._end - range._begin <= outPointTree._leafPointCount)
+		{
+			continue;
+		}
+
+		const float3 extents = range._bbMax - range._bbMin;
+		uint32 axis = (extents.y < extents.x) ? 0 : 1;
+		axis = (extents[axis] < extents.z) ? 2 : axis;
+
+		const uint32 middle = range._begin + (range._end - range._begin) / 2;
+		std::nth_element(nodes + range._begin, nodes + middle, nodes + range._end, [axis](const PointKdNode& lhs, const PointKdNode& rhs)
+			{
+				return lhs._position[axis] < rhs._position[axis];
+			});
+
+		PointKdNode& splitNode = nodes[middle];
+		splitNode._parameter = splitNode.getPointIndex() | (axis << kPointKdAxisShift);
+
+		PointKdBuildRange leftRange = { range._begin, middle, range._bbMin, range._bbMax };
+		PointKdBuildRange rightRange = { middle + 1, range._end, range._bbMin, range._bbMax };
+		leftRange._bbMax[axis] = splitNode._position[axis];
+		rightRange._bbMin[axis] = splitNode._position[axis];
+
+		rangeStack.push_back(leftRange);
+		rangeStack.push_back(rightRange);
+	}
+}
+
+// Note(jinpark) : near side first, the far side is pushed with the squared plane distance and dropped
+//				   when it pops farther than collector.getMaxDistance2().
+template <typename Collector>
+static void searchPointTree(const PointKdTree& pointTree, const float3& position, Collector& collector)
+{
+	const PointKdNode* nodes = pointTree._nodeArray.data();
+	const uint32 leafPointCount = pointTree._leafPointCount;
+
+	PointKdSearchRange rangeStack[kPointKdStackSize];
+	uint32 stackSize = 0;
+	rangeStack[stackSize++] = { 0, static_cast<uint32>(pointTree._nodeArray.size()), 0.0f };
+
+	while (0 < stackSize)
+	{
+		const PointKdSearchRange range = rangeStack[--stackSize];
+		if (collector.getMaxDistance2() < range._distance2)
+		{
+			continue;
+		}
+
+		uint32 begin = range._begin;
+		uint32 end = range._end;
+		while (leafPointCount < end - begin)
+		{
+			const uint32 middle = begin + (end - begin) / 2;
+			const PointKdNode& splitNode = nodes[middle];
+			collector.add(splitNode, computeDistance2(position, splitNode._position));
+
+			const uint32 axis = splitNode.getAxis();
+			const float planeDistance = position[axis] - splitNode._position[axis];
+			const float planeDistance2 = std::max(range._distance2, planeDistance * planeDistance);
+
+			const bool isLeftNear = (planeDistance < 0.0f);
+			if (planeDistance2 <= collector.getMaxDistance2())
+			{
+				assert(stackSize < kPointKdStackSize);
+				rangeStack[stackSize++] = (true == isLeftNear) ? PointKdSearchRange{ middle + 1, end, planeDistance2 } : PointKdSearchRange{ begin, middle, planeDistance2 };
+			}
+
+			if (true == isLeftNear)
+			{
+				end = middle;
+			}
+			else
+			{
+				begin = middle + 1;
+			}
+		}
+
+		for (uint32 nodeIndex = begin; nodeIndex < end; ++nodeIndex)
+		{
+			collector.add(nodes[nodeIndex], computeDistance2(position, nodes[nodeIndex]._position));
+		}
+	}
+}
+
+// Note(jinpark) : bounded max-heap, the farthest of the k kept points is the front and the pruning distance once full.
+class PointKdNearestCollector
+{
+public:
+	PointKdNearestCollector(std::vector<PointKdNeighbor>& neighbors, const uint32 k, const float maxDistance2)
+		: _neighbors(neighbors), _k(k), _maxDistance2(maxDistance2)
+	{
+		_neighbors.clear();
+	}
+
+	float getMaxDistance2() const { return _maxDistance2; }
+
+	void add(const PointKdNode& node, const float distance2)
+	{
+		if (_maxDistance2 < distance2)
+		{
+			return;
+		}
+
+		if (_neighbors.size() == _k)
+		{
+			std::pop_heap(_neighbors.begin(), _neighbors.end(), compareNeighbor);
+			_neighbors.back() = { distance2, node.getPointIndex() };
+		}
+		else
+		{
+			_neighbors.push_back({ distance2, node.getPointIndex() });
+		}
+		std::push_heap(_neighbors.begin(), _neighbors.end(), compareNeighbor);
+
+		if (_neighbors.size() == _k)
+		{
+			_maxDistance2 = _neighbors.front()._distance2;
+		}
+	}
+
+private:
+	std::vector<PointKdNeighbor>& _neighbors;
+	const size_t _k;
+	float _maxDistance2;
+};
+
+class PointKdRadiusCollector
+{
+public:
+	PointKdRadiusCollector(std::vector<PointKdNeighbor>& neighbors, const float radius2)
+		: _neighbors(neighbors), _radius2(radius2)
+	{
+		_neighbors.clear();
+	}
+
+	float getMaxDistance2() const { return _radius2; }
+
+	void add(const PointKdNode& node, const float distance2)
+	{
+		if (distance2 <= _radius2)
+		{
+			_neighbors.push_back({ distance2, node.getPointIndex() });
+		}
+	}
+
+private:
+	std::vector<PointKdNeighbor>& _neighbors;
+	const float _radius2;
+};
+
+uint32 PointKdTreeSearch::findNearest(std::vector<PointKdNeighbor>& outNeighbors, const PointKdTree& pointTree, const float3& position, const uint32 k, const float maxDistance)
+{
+	PointKdNearestCollector collector(outNeighbors, k, (FLT_MAX == maxDistance) ? FLT_MAX : maxDistance * maxDistance);
+	if ((0 == k) || (true == pointTree._nodeArray.empty()))
+	{
+		return 0;
+	}
+
+	searchPointTree(pointTree, position, collector);
+
+	std::sort_heap(outNeighbors.begin(), outNeighbors.end(), compareNeighbor);
+	return static_cast<uint32>(outNeighbors.size());
+}
+
+uint32 PointKdTreeSearch::findNearest(std::vector<PointKdNeighbor>& outNeighbors, const PointKdTree& pointTree, const float3& position, const uint32 k, const float maxDistance, const PointKdSearchSettings& settings)
+{
+	PointKdNearestCollector collector(outNeighbors, k, (FLT_MAX == maxDistance) ? FLT_MAX : maxDistance * maxDistance);
+	if ((0 == k) || (true == pointTree._nodeArray.empty()) || (0 == settings._maxLeafCount))
+	{
+		return 0;
+	}
+
+	const PointKdNode* nodes = pointTree._nodeArray.data();
+	const uint32 leafPointCount = pointTree._leafPointCount;
+
+	// Note(jinpark) : a range is worth visiting only if it can hold a point nearer than the k-th distance / (1 + epsilon).
+	const float errorScale2 = (1.0f + settings._epsilon) * (1.0f + settings._epsilon);
+
+	// Note(jinpark) : min-heap on the range box distance, unlike the exact walk it can hold more than one range per level.
+	std::vector<PointKdPriorityRange> rangeHeap;
+	rangeHeap.push_back({ 0, static_cast<uint32>(pointTree._nodeArray.size()), 0.0f, float3(0.0f, 0.0f, 0.0f) });
+
+	uint32 leafCount = 0;
+	while (false == rangeHeap.empty())
+	{
+		std::pop_heap(rangeHeap.begin(), rangeHeap.end(), compareSearchRange);
+		const PointKdPriorityRange range = rangeHeap.back();
+		rangeHeap.pop_back();
+
+		// Note(jinpark) : the heap is ordered, so no pending range is nearer either.
+		if (collector.getMaxDistance2() < range._distance2 * errorScale2)
+		{
+			break;
+		}
+
+		uint32 begin = range._begin;
+		uint32 end = range._end;
+		while (leafPointCount < end - begin)
+		{
+			const uint32 middle = begin + (end - begin) / 2;
+			const PointKdNode& splitNode = nodes[middle];
+			collector.add(splitNode, computeDistance2(position, splitNode._position));
+
+			// Note(jinpark) : the far box only moves away along the split axis, its distance is updated on that axis alone.
+			const uint32 axis = splitNode.getAxis();
+			const float planeDistance = position[axis] - splitNode._position[axis];
+			const float farDistance2 = range._distance2 - range._offset[axis] * range._offset[axis] + planeDistance * planeDistance;
+
+			const bool isLeftNear = (planeDistance < 0.0f);
+			if (farDistance2 * errorScale2 <= collector.getMaxDistance2())
+			{
+				PointKdPriorityRange farRange = (true == isLeftNear) ? PointKdPriorityRange{ middle + 1, end, farDistance2, range._offset } : PointKdPriorityRange{ begin, middle, farDistance2, range._offset };
+				farRange._offset[axis] = planeDistance;
+
+				rangeHeap.push_back(farRange);
+				std::push_heap(rangeHeap.begin(), rangeHeap.end(), compareSearchRange);
+			}
+
+			if (true == isLeftNear)
+			{
+				end = middle;
+			}
+			else
+			{
+				begin = middle + 1;
+			}
+		}
+
+		for (uint32 nodeIndex = begin; nodeIndex < end; ++nodeIndex)
+		{
+			collector.add(nodes[nodeIndex], computeDistance2(position, nodes[nodeIndex]._position));
+		}
+
+		if (settings._maxLeafCount <= ++leafCount)
+		{
+			break;
+		}
+	}
+
+	std::sort_heap(outNeighbors.begin(), outNeighbors.end(), compareNeighbor);
+	return static_cast<uint32>(outNeighbors.size());
+}
+
+uint32 PointKdTreeSearch::findInRadius(std::vector<PointKdNeighbor>& outNeighbors, const PointKdTree& pointTree, const float3& position, const float radius)
+{
+	PointKdRadiusCollector collector(outNeighbors, radius * radius);
+	if (true == pointTree._nodeArray.empty())
+	{
+		return 0;
+	}
+
+	searchPointTree(pointTree, position, collector);
+	return static_cast<uint32>(outNeighbors.size());
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Common/Common.h"
+#include "float3.h"
+#include <vector>
+
+const uint32 kPointKdAxisShift = 30;
+const uint32 kPointKdIndexMask = (1u << kPointKdAxisShift) - 1;
+const uint32 kPointKdLeafAxis = 3;
+const uint32 kPointKdMaxPointCount = kPointKdIndexMask;
+
+// Note(jinpark) : 16 bytes, source point index in the low 30 bits, split axis in the high 2 bits (kPointKdLeafAxis in leaves).
+struct PointKdNode
+{
+	float3 _position;
+	uint32 _parameter;
+
+	uint32 getPointIndex() const { return _parameter & kPointKdIndexMask; }
+	uint32 getAxis() const { return _parameter >> kPointKdAxisShift; }
+};
+
+// Note(jinpark) : implicit median tree, no child links. the subtree of range [begin, end) splits at its middle node,
+//				   left is [begin, middle) and right is [middle + 1, end). ranges of _leafPointCount or less are leaves
+//				   and are scanned linearly.
+struct PointKdTree
+{
+	uint32 _leafPointCount = 8;
+	std::vector<PointKdNode> _nodeArray;
+};
+
+struct PointKdNeighbor
+{
+	float _distance2;
+	uint32 _pointIndex;
+};
+
+// Note(jinpark) : approximate search, every returned distance is within (1 + _epsilon) of the true k-th nearest one
+//				   unless the leaf cap stops it first. _epsilon 0 and no cap is the exact answer.
+struct PointKdSearchSettings
+{
+	float _epsilon = 0.0f;
+	uint32 _maxLeafCount = 0xffffffff;
+};
+
+class PointKdTreeSearch
+{
+public:
+	static void build(PointKdTree& outPointTree, const void* points, const uint32 stride, const uint32 pointCount, const uint32 leafPointCount = 8);
+
+	// Note(jinpark) : up to k nearest points within maxDistance, nearest first. returns the count found.
+	static uint32 findNearest(std::vector<PointKdNeighbor>& outNeighbors, const PointKdTree& pointTree, const float3& position, const uint32 k, const float maxDistance);
+
+	// Note(jinpark) : priority search, ranges are visited nearest first and the search stops once the nearest pending
+	//				   range is farther than the k-th distance / (1 + _epsilon) or _maxLeafCount leaves were scanned.
+	static uint32 findNearest(std::vector<PointKdNeighbor>& outNeighbors, const PointKdTree& pointTree, const float3& position, const uint32 k, const float maxDistance, const PointKdSearchSettings& settings);
+
+	// Note(jinpark) : every point within radius, unordered. returns the count found.
+	static uint32 findInRadius(std::vector<PointKdNeighbor>& outNeighbors, const PointKdTree& pointTree, const float3& position, const float radius);
+};
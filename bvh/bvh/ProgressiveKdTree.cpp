@@ -0,0 +1,172 @@
+#include "ProgressiveKdTree.h"
+#include <algorithm>
+
+const uint32 kRefineLeafDivisor = 8;
+const uint32 kMinRangeLeafPrimitiveCount = 4;
+
+static float3 getVertex(const void* vertices, uint32 vertexIndex, uint32 stride)
+{
+	const float3* position = reinterpret_cast<const float3*>(reinterpret_cast<const char*>(vertices) + (vertexIndex * stride));
+	return *position;
+}
+
+ProgressiveKdTree::~ProgressiveKdTree()
+{
+	cancel();
+}
+
+void ProgressiveKdTree::cancel()
+{
+	_isCancelled.store(true, std::memory_order_release);
+	if (_refineThread.joinable())
+	{
+		_refineThread.join();
+	}
+}
+
+std::shared_ptr<const ProgressiveKdTree::Version> ProgressiveKdTree::buildVersion(KdPrimitiveArray& primitiveArray, const uint32 maxLeafPrimitiveCount)
+{
+	std::shared_ptr<Version> version = std::make_shared<Version>();
+	version->_maxLeafPrimitiveCount = maxLeafPrimitiveCount;
+
+	KdTree::buildRangeNodeArray(version->_nodeArray, primitiveArray, maxLeafPrimitiveCount);
+	version->_primitiveIndexArray = primitiveArray._primitiveIndexArray;
+
+	return version;
+}
+
+void ProgressiveKdTree::publish(std::shared_ptr<const Version> version)
+{
+	std::lock_guard<std::mutex> lock(_versionMutex);
+	_version = std::move(version);
+}
+
+std::shared_ptr<const ProgressiveKdTree::Version> ProgressiveKdTree::getVersion() const
+{
+	std::lock_guard<std::mutex> lock(_versionMutex);
+	return _version;
+}
+
+void ProgressiveKdTree::build(const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount, const uint32 coarseNodeBudget)
+{
+	assert(0 == (indexCount % 3));
+	assert(0 < coarseNodeBudget);
+
+	cancel();
+
+	_vertices = vertices;
+	_stride = stride;
+	_indices = indices;
+	_indexCount = indexCount;
+	_isCancelled.store(false, std::memory_order_relaxed);
+	_isFinished.store(false, std::memory_order_relaxed);
+
+	KdPrimitiveArray primitiveArray;
+	KdTree::buildPrimitiveArray(primitiveArray, vertices, stride, indices, indexCount);
+
+	// Note(jinpark) : nodeCount is about 2 * leafCount, so this keeps the coarse tree around the budget.
+	const uint32 primitiveCount = primitiveArray.getCount();
+	const uint32 maxLeafPrimitiveCount = std::max(1u, (primitiveCount * 2 + coarseNodeBudget - 1) / coarseNodeBudget);
+
+	publish(buildVersion(primitiveArray, maxLeafPrimitiveCount));
+
+	_refineThread = std::thread(&ProgressiveKdTree::refine, this, std::move(primitiveArray), maxLeafPrimitiveCount);
+}
+
+void ProgressiveKdTree::refine(KdPrimitiveArray primitiveArray, uint32 maxLeafPrimitiveCount)
+{
+	while (kMinRangeLeafPrimitiveCount < maxLeafPrimitiveCount)
+	{
+		if (true == _isCancelled.load(std::memory_order_acquire))
+		{
+			return;
+		}
+
+		maxLeafPrimitiveCount = std::max(kMinRangeLeafPrimitiveCount, maxLeafPrimitiveCount / kRefineLeafDivisor);
+		publish(buildVersion(primitiveArray, maxLeafPrimitiveCount));
+	}
+
+	primitiveArray = KdPrimitiveArray();
+	if (true == _isCancelled.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	std::shared_ptr<Version> finalVersion = std::make_shared<Version>();
+	finalVersion->_maxLeafPrimitiveCount = 1;
+
+	KdTree kdTree;
+	kdTree.build(finalVersion->_packedNodeArray, _vertices, _stride, _indices, _indexCount);
+
+	publish(finalVersion);
+	_isFinished.store(true, std::memory_order_release);
+}
+
+bool ProgressiveKdTree::intersect(KdTreeHit& outHit, const float3& origin, const float3& direction, float tMax) const
+{
+	const std::shared_ptr<const Version> version = getVersion();
+	if (nullptr == version)
+	{
+		return false;
+	}
+
+	if (false == version->_packedNodeArray.empty())
+	{
+		return KdTreeTraversal::intersect(outHit, version->_packedNodeArray, origin, direction, tMax);
+	}
+
+	const std::vector<RangeKdNode>& nodeArray = version->_nodeArray;
+	if (true == nodeArray.empty())
+	{
+		return false;
+	}
+
+	const KdTreeRay ray(origin, direction);
+
+	bool isHit = false;
+
+	uint32 nodeIndex = 0;
+	while (0xffffffff != nodeIndex)
+	{
+		const RangeKdNode& node = nodeArray[nodeIndex];
+
+		const bool isBoxHit = KdTreeTraversal::intersectBox(node._bbMin, node._bbMax, ray, tMax);
+		if (false == isBoxHit)
+		{
+			nodeIndex = node._nextNodeIndex;
+			continue;
+		}
+
+		const bool isLeafNode = (0xffffffff != node._primitiveIndex);
+		if (false == isLeafNode)
+		{
+			++nodeIndex;
+			continue;
+		}
+
+		for (uint32 i = node._beginIndex; i < node._endIndex; ++i)
+		{
+			const uint32 primitiveIndex = version->_primitiveIndexArray[i];
+
+			const float3 position0 = getVertex(_vertices, _indices[primitiveIndex * 3 + 0], _stride);
+			const float3 position1 = getVertex(_vertices, _indices[primitiveIndex * 3 + 1], _stride);
+			const float3 position2 = getVertex(_vertices, _indices[primitiveIndex * 3 + 2], _stride);
+
+			float t, u, v;
+			if (KdTreeTraversal::intersectTriangle(t, u, v, origin, direction, position0, position1 - position0, position2 - position0) && (0.0f < t) && (t < tMax))
+			{
+				tMax = t;
+
+				outHit._t = t;
+				outHit._u = u;
+				outHit._v = v;
+				outHit._primitiveIndex = primitiveIndex;
+				isHit = true;
+			}
+		}
+
+		nodeIndex = node._nextNodeIndex;
+	}
+
+	return isHit;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "KdTree.h"
+#include "KdTreeTraversal.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Note(jinpark) : build() publishes a coarse tree with multi-primitive leaves within the node budget,
+//				   then a background thread refines it and publishes every improved version.
+//				   the last version is the same packed tree as KdTree::build.
+//				   vertices/indices are referenced, not copied. they must outlive the tree.
+class ProgressiveKdTree
+{
+public:
+	struct Version
+	{
+		uint32 _maxLeafPrimitiveCount = 0;
+
+		std::vector<RangeKdNode> _nodeArray;
+		std::vector<uint32> _primitiveIndexArray;
+
+		// Note(jinpark) : only the final version has packed nodes.
+		std::vector<PackedKdNode> _packedNodeArray;
+	};
+
+public:
+	ProgressiveKdTree() = default;
+	~ProgressiveKdTree();
+
+	DISALLOW_ASSIGN_COPY(ProgressiveKdTree);
+
+public:
+	void build(const void* vertices, uint32 stride, const uint32* indices, const uint32 indexCount, const uint32 coarseNodeBudget = 1024);
+	void cancel();
+
+	bool intersect(KdTreeHit& outHit, const float3& origin, const float3& direction, float tMax) const;
+
+	std::shared_ptr<const Version> getVersion() const;
+	bool isFinished() const { return _isFinished.load(std::memory_order_acquire); }
+
+private:
+	void refine(KdPrimitiveArray primitiveArray, uint32 maxLeafPrimitiveCount);
+	void publish(std::shared_ptr<const Version> version);
+
+	static std::shared_ptr<const Version> buildVersion(KdPrimitiveArray& primitiveArray, const uint32 maxLeafPrimitiveCount);
+
+private:
+	const void* _vertices = nullptr;
+	uint32 _stride = 0;
+	const uint32* _indices = nullptr;
+	uint32 _indexCount = 0;
+
+	mutable std::mutex _versionMutex;
+	std::shared_ptr<const Version> _version;
+
+	std::thread _refineThread;
+	std::atomic<bool> _isCancelled{ false };
+	std::atomic<bool> _isFinished{ false };
+};
@@ -0,0 +1,500 @@
+#include "SpatialKdTree.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+enum class SpatialKdEventType : uint32
+{
+	End,		// Note(jinpark) : ends sort first, so a triangle ending on a plane is on the left of it
+	Planar,
+	Start,
+};
+
+struct SpatialKdEvent
+{
+	float _position;
+	uint32 _triangleIndex;
+	uint32 _axis;
+	SpatialKdEventType _type;
+
+	bool operator<(const SpatialKdEvent& rhs) const
+	{
+		if (_axis != rhs._axis)
+		{
+			return _axis < rhs._axis;
+		}
+		if (_position != rhs._position)
+		{
+			return _position < rhs._position;
+		}
+		return _type < rhs._type;
+	}
+};
+
+enum class SpatialKdSide : uchar
+{
+	Both,
+	LeftOnly,
+	RightOnly,
+};
+
+struct SpatialKdSplit
+{
+	uint32 _axis = 0;
+	float _position = 0.0f;
+	bool _isPlanarLeft = false;
+	float _cost = FLT_MAX;
+};
+
+struct SpatialKdBuildContext
+{
+	SpatialKdTreeSettings _settings;
+	uint32 _maxDepth = 0;
+
+	SpatialKdTree* _tree = nullptr;
+	std::vector<float3> _positionArray;		// Note(jinpark) : 3 corners per triangle
+	std::vector<SpatialKdSide> _sideArray;	// Note(jinpark) : per triangle, only valid for the node being split
+};
+
+static float computeSurfaceArea(const float3& bbMin, const float3& bbMax)
+{
+	const float3 extents = (bbMax - bbMin);
+	return (extents.x * extents.y + extents.y * extents.z + extents.x * extents.z) * 2.0f;
+}
+
+static void addTriangleEvents(std::vector<SpatialKdEvent>& outEvents, const uint32 triangleIndex, const float3& bbMin, const float3& bbMax)
+{
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		if (bbMin[axisIndex] == bbMax[axisIndex])
+		{
+			outEvents.push_back({ bbMin[axisIndex], triangleIndex, axisIndex, SpatialKdEventType::Planar });
+		}
+		else
+		{
+			outEvents.push_back({ bbMin[axisIndex], triangleIndex, axisIndex, SpatialKdEventType::Start });
+			outEvents.push_back({ bbMax[axisIndex], triangleIndex, axisIndex, SpatialKdEventType::End });
+		}
+	}
+}
+
+// Note(jinpark) : Sutherland-Hodgman against the 6 box planes, the bound of what is left is the triangle inside the box.
+static bool clipTriangleBound(float3& outBBMin, float3& outBBMax, const float3* positions, const float3& bbMin, const float3& bbMax)
+{
+	float3 polygons[2][9];
+	uint32 vertexCount = 3;
+	polygons[0][0] = positions[0];
+	polygons[0][1] = positions[1];
+	polygons[0][2] = positions[2];
+
+	uint32 source = 0;
+	for (uint32 planeIndex = 0; planeIndex < 6; ++planeIndex)
+	{
+		const uint32 axis = planeIndex >> 1;
+		const bool isMaxPlane = (0 != (planeIndex & 1));
+		const float plane = isMaxPlane ? bbMax[axis] : bbMin[axis];
+
+		const float3* input = polygons[source];
+		float3* output = polygons[source ^ 1];
+		uint32 outputCount = 0;
+
+		for (uint32 vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex)
+		{
+			const float3& current = input[vertexIndex];
+			const float3& next = input[(vertexIndex + 1) % vertexCount];
+
+			const float currentDistance = isMaxPlane ? (plane - current[axis]) : (current[axis] - plane);
+			const float nextDistance = isMaxPlane ? (plane - next[axis]) : (next[axis] - plane);
+
+			if (0.0f <= currentDistance)
+			{
+				output[outputCount++] = current;
+			}
+			if ((0.0f <= currentDistance) != (0.0f <= nextDistance))
+			{
+				const float s = currentDistance / (currentDistance - nextDistance);
+				float3 position = current + (next - current) * s;
+				position[axis] = plane;
+				output[outputCount++] = position;
+			}
+		}
+
+		vertexCount = outputCount;
+		source ^= 1;
+		if (0 == vertexCount)
+		{
+			return false;
+		}
+	}
+
+	outBBMin = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+	outBBMax = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32 vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex)
+	{
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			outBBMin[axisIndex] = std::min(outBBMin[axisIndex], polygons[source][vertexIndex][axisIndex]);
+			outBBMax[axisIndex] = std::max(outBBMax[axisIndex], polygons[source][vertexIndex][axisIndex]);
+		}
+	}
+
+	// Note(jinpark) : the interpolated points can round just outside the box.
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		outBBMin[axisIndex] = std::max(outBBMin[axisIndex], bbMin[axisIndex]);
+		outBBMax[axisIndex] = std::min(outBBMax[axisIndex], bbMax[axisIndex]);
+	}
+	return true;
+}
+
+static float computeSplitCost(const SpatialKdTreeSettings& settings, const float leftProbability, const float rightProbability, const uint32 leftCount, const uint32 rightCount)
+{
+	const float cost = settings._traversalCost + settings._intersectionCost * (leftProbability * leftCount + rightProbability * rightCount);
+	return ((0 == leftCount) || (0 == rightCount)) ? cost * (1.0f - settings._emptyBonus) : cost;
+}
+
+// Note(jinpark) : one sweep over the sorted events of all 3 axes. events at the same position are taken as a group,
+//				   ends leave the right side before the plane is evaluated and starts join the left side after it.
+static SpatialKdSplit findSplit(const SpatialKdTreeSettings& settings, const std::vector<SpatialKdEvent>& events, const uint32 triangleCount, const float3& bbMin, const float3& bbMax)
+{
+	SpatialKdSplit bestSplit;
+
+	const float area = computeSurfaceArea(bbMin, bbMax);
+	if (area <= 0.0f)
+	{
+		return bestSplit;
+	}
+	const float inverseArea = 1.0f / area;
+
+	uint32 leftCount[3] = { 0, 0, 0 };
+	uint32 rightCount[3] = { triangleCount, triangleCount, triangleCount };
+
+	const uint32 eventCount = static_cast<uint32>(events.size());
+	uint32 eventIndex = 0;
+	while (eventIndex < eventCount)
+	{
+		const uint32 axis = events[eventIndex]._axis;
+		const float position = events[eventIndex]._position;
+
+		uint32 typeCount[3] = { 0, 0, 0 };
+		while ((eventIndex < eventCount) && (axis == events[eventIndex]._axis) && (position == events[eventIndex]._position))
+		{
+			++typeCount[static_cast<uint32>(events[eventIndex]._type)];
+			++eventIndex;
+		}
+
+		const uint32 endCount = typeCount[static_cast<uint32>(SpatialKdEventType::End)];
+		const uint32 planarCount = typeCount[static_cast<uint32>(SpatialKdEventType::Planar)];
+		const uint32 startCount = typeCount[static_cast<uint32>(SpatialKdEventType::Start)];
+
+		rightCount[axis] -= planarCount + endCount;
+
+		// Note(jinpark) : planes on the node bound make an empty child of no volume, they never pay off.
+		if ((bbMin[axis] < position) && (position < bbMax[axis]))
+		{
+			float3 leftBBMax = bbMax;
+			float3 rightBBMin = bbMin;
+			leftBBMax[axis] = position;
+			rightBBMin[axis] = position;
+
+			const float leftProbability = computeSurfaceArea(bbMin, leftBBMax) * inverseArea;
+			const float rightProbability = computeSurfaceArea(rightBBMin, bbMax) * inverseArea;
+
+			const float planarLeftCost = computeSplitCost(settings, leftProbability, rightProbability, leftCount[axis] + planarCount, rightCount[axis]);
+			const float planarRightCost = computeSplitCost(settings, leftProbability, rightProbability, leftCount[axis], rightCount[axis] + planarCount);
+
+			const float cost = std::min(planarLeftCost, planarRightCost);
+			if (cost < bestSplit._cost)
+			{
+				bestSplit._axis = axis;
+				bestSplit._position = position;
+				bestSplit._isPlanarLeft = (planarLeftCost <= planarRightCost);
+				bestSplit._cost = cost;
+			}
+		}
+
+		leftCount[axis] += startCount + planarCount;
+	}
+
+	return bestSplit;
+}
+
+static void buildLeaf(SpatialKdTree& outSpatialTree, const uint32 nodeIndex, const std::vector<uint32>& triangles, const float3& bbMin, const float3& bbMax)
+{
+	SpatialKdLeaf leaf;
+	leaf._bbMin = bbMin;
+	leaf._bbMax = bbMax;
+	leaf._referenceBegin = static_cast<uint32>(outSpatialTree._referenceArray.size());
+	leaf._referenceCount = static_cast<uint32>(triangles.size());
+	std::fill(leaf._ropeArray, leaf._ropeArray + 6, 0xffffffff);
+
+	outSpatialTree._referenceArray.insert(outSpatialTree._referenceArray.end(), triangles.begin(), triangles.end());
+
+	SpatialKdNode& node = outSpatialTree._nodeArray[nodeIndex];
+	node._split = 0.0f;
+	node._parameter = (static_cast<uint32>(outSpatialTree._leafArray.size()) << kSpatialKdIndexShift) | kSpatialKdLeafAxis;
+
+	outSpatialTree._leafArray.push_back(leaf);
+}
+
+static void buildSpatialNode(SpatialKdBuildContext& context, std::vector<SpatialKdEvent>& events, std::vector<uint32>& triangles, const float3& bbMin, const float3& bbMax, const uint32 depth)
+{
+	SpatialKdTree& outSpatialTree = *context._tree;
+
+	const uint32 nodeIndex = static_cast<uint32>(outSpatialTree._nodeArray.size());
+	outSpatialTree._nodeArray.emplace_back();
+
+	// Note(jinpark) : 1 step - best split, a leaf when it costs more than intersecting everything here
+	const uint32 triangleCount = static_cast<uint32>(triangles.size());
+	const SpatialKdSplit split = findSplit(context._settings, events, triangleCount, bbMin, bbMax);
+
+	const float leafCost = context._settings._intersectionCost * triangleCount;
+	if ((0 == triangleCount) || (context._maxDepth <= depth) || (leafCost <= split._cost))
+	{
+		buildLeaf(outSpatialTree, nodeIndex, triangles, bbMin, bbMax);
+		return;
+	}
+
+	// Note(jinpark) : 2 step - classify triangles by their events on the split axis, what is not decided straddles the plane
+	for (const uint32 triangleIndex : triangles)
+	{
+		context._sideArray[triangleIndex] = SpatialKdSide::Both;
+	}
+
+	for (const SpatialKdEvent& event : events)
+	{
+		if (split._axis != event._axis)
+		{
+			continue;
+		}
+
+		if ((SpatialKdEventType::End == event._type) && (event._position <= split._position))
+		{
+			context._sideArray[event._triangleIndex] = SpatialKdSide::LeftOnly;
+		}
+		else if ((SpatialKdEventType::Start == event._type) && (split._position <= event._position))
+		{
+			context._sideArray[event._triangleIndex] = SpatialKdSide::RightOnly;
+		}
+		else if (SpatialKdEventType::Planar == event._type)
+		{
+			const bool isLeft = (event._position < split._position) || ((event._position == split._position) && (true == split._isPlanarLeft));
+			context._sideArray[event._triangleIndex] = isLeft ? SpatialKdSide::LeftOnly : SpatialKdSide::RightOnly;
+		}
+	}
+
+	// Note(jinpark) : 3 step - one sided events keep their order, straddling triangles are clipped to each child
+	//				   and their new events are sorted and merged in, which keeps the whole build O(n log n).
+	float3 leftBBMax = bbMax;
+	float3 rightBBMin = bbMin;
+	leftBBMax[split._axis] = split._position;
+	rightBBMin[split._axis] = split._position;
+
+	std::vector<SpatialKdEvent> leftOnlyEvents, rightOnlyEvents;
+	for (const SpatialKdEvent& event : events)
+	{
+		const SpatialKdSide side = context._sideArray[event._triangleIndex];
+		if (SpatialKdSide::LeftOnly == side)
+		{
+			leftOnlyEvents.push_back(event);
+		}
+		else if (SpatialKdSide::RightOnly == side)
+		{
+			rightOnlyEvents.push_back(event);
+		}
+	}
+
+	std::vector<uint32> leftTriangles, rightTriangles;
+	std::vector<SpatialKdEvent> leftBothEvents, rightBothEvents;
+	for (const uint32 triangleIndex : triangles)
+	{
+		const SpatialKdSide side = context._sideArray[triangleIndex];
+		if (SpatialKdSide::LeftOnly == side)
+		{
+			leftTriangles.push_back(triangleIndex);
+			continue;
+		}
+		if (SpatialKdSide::RightOnly == side)
+		{
+			rightTriangles.push_back(triangleIndex);
+			continue;
+		}
+
+		const float3* positions = &context._positionArray[triangleIndex * 3];
+
+		float3 clippedBBMin, clippedBBMax;
+		if (true == clipTriangleBound(clippedBBMin, clippedBBMax, positions, bbMin, leftBBMax))
+		{
+			leftTriangles.push_back(triangleIndex);
+			addTriangleEvents(leftBothEvents, triangleIndex, clippedBBMin, clippedBBMax);
+		}
+		if (true == clipTriangleBound(clippedBBMin, clippedBBMax, positions, rightBBMin, bbMax))
+		{
+			rightTriangles.push_back(triangleIndex);
+			addTriangleEvents(rightBothEvents, triangleIndex, clippedBBMin, clippedBBMax);
+		}
+	}
+
+	// Note(jinpark) : the parent lists are not needed below here, free them before going deeper.
+	std::vector<SpatialKdEvent>().swap(events);
+	std::vector<uint32>().swap(triangles);
+
+	std::sort(leftBothEvents.begin(), leftBothEvents.end());
+	std::sort(rightBothEvents.begin(), rightBothEvents.end());
+
+	std::vector<SpatialKdEvent> leftEvents(leftOnlyEvents.size() + leftBothEvents.size());
+	std::merge(leftOnlyEvents.begin(), leftOnlyEvents.end(), leftBothEvents.begin(), leftBothEvents.end(), leftEvents.begin());
+	std::vector<SpatialKdEvent>().swap(leftOnlyEvents);
+	std::vector<SpatialKdEvent>().swap(leftBothEvents);
+
+	std::vector<SpatialKdEvent> rightEvents(rightOnlyEvents.size() + rightBothEvents.size());
+	std::merge(rightOnlyEvents.begin(), rightOnlyEvents.end(), rightBothEvents.begin(), rightBothEvents.end(), rightEvents.begin());
+	std::vector<SpatialKdEvent>().swap(rightOnlyEvents);
+	std::vector<SpatialKdEvent>().swap(rightBothEvents);
+
+	// Note(jinpark) : 4 step - children in pre-order, the right child index is known once the left subtree is done
+	buildSpatialNode(context, leftEvents, leftTriangles, bbMin, leftBBMax, depth + 1);
+
+	SpatialKdNode& node = outSpatialTree._nodeArray[nodeIndex];
+	node._split = split._position;
+	node._parameter = (static_cast<uint32>(outSpatialTree._nodeArray.size()) << kSpatialKdIndexShift) | split._axis;
+
+	buildSpatialNode(context, rightEvents, rightTriangles, rightBBMin, bbMax, depth + 1);
+}
+
+// Note(jinpark) : moves the rope down while a single child of the neighbour covers the whole face of the leaf.
+static uint32 optimizeRope(const SpatialKdTree& spatialTree, uint32 ropeIndex, const uint32 faceIndex, const float3& bbMin, const float3& bbMax)
+{
+	const uint32 faceAxis = faceIndex >> 1;
+	const bool isMaxFace = (0 != (faceIndex & 1));
+
+	while (0xffffffff != ropeIndex)
+	{
+		const SpatialKdNode& node = spatialTree._nodeArray[ropeIndex];
+		if (true == node.isLeaf())
+		{
+			break;
+		}
+
+		const uint32 axis = node.getAxis();
+		if (faceAxis == axis)
+		{
+			// Note(jinpark) : the child on our side of the neighbour, the left one beyond a max face.
+			ropeIndex = (true == isMaxFace) ? (ropeIndex + 1) : node.getIndex();
+		}
+		else if (node._split <= bbMin[axis])
+		{
+			ropeIndex = node.getIndex();
+		}
+		else if (bbMax[axis] <= node._split)
+		{
+			ropeIndex = ropeIndex + 1;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return ropeIndex;
+}
+
+static void buildRopes(SpatialKdTree& outSpatialTree, const uint32 nodeIndex, const uint32* ropes)
+{
+	const SpatialKdNode node = outSpatialTree._nodeArray[nodeIndex];
+	if (true == node.isLeaf())
+	{
+		SpatialKdLeaf& leaf = outSpatialTree._leafArray[node.getIndex()];
+		for (uint32 faceIndex = 0; faceIndex < 6; ++faceIndex)
+		{
+			leaf._ropeArray[faceIndex] = optimizeRope(outSpatialTree, ropes[faceIndex], faceIndex, leaf._bbMin, leaf._bbMax);
+		}
+		return;
+	}
+
+	const uint32 axis = node.getAxis();
+	const uint32 leftIndex = nodeIndex + 1;
+	const uint32 rightIndex = node.getIndex();
+
+	uint32 leftRopes[6], rightRopes[6];
+	std::copy(ropes, ropes + 6, leftRopes);
+	std::copy(ropes, ropes + 6, rightRopes);
+	leftRopes[axis * 2 + 1] = rightIndex;
+	rightRopes[axis * 2 + 0] = leftIndex;
+
+	buildRopes(outSpatialTree, leftIndex, leftRopes);
+	buildRopes(outSpatialTree, rightIndex, rightRopes);
+}
+
+void SpatialKdTreeBuilder::build(SpatialKdTree& outSpatialTree, const KdTreeMeshView& meshView, const SpatialKdTreeSettings& settings)
+{
+	outSpatialTree._nodeArray.clear();
+	outSpatialTree._leafArray.clear();
+	outSpatialTree._referenceArray.clear();
+	outSpatialTree._triangleArray.clear();
+
+	const uint32 triangleCount = meshView._indexCount / 3;
+	if (0 == triangleCount)
+	{
+		outSpatialTree._bbMin = outSpatialTree._bbMax = float3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	SpatialKdBuildContext context;
+	context._settings = settings;
+	context._maxDepth = (0 != settings._maxDepth) ? settings._maxDepth : static_cast<uint32>(8.0f + 1.3f * log2f(static_cast<float>(triangleCount)));
+	context._tree = &outSpatialTree;
+	context._positionArray.resize(triangleCount * 3);
+	context._sideArray.resize(triangleCount);
+
+	// Note(jinpark) : 1 step - decode corners once, the triangle table and the initial events come from them
+	outSpatialTree._triangleArray.resize(triangleCount * 3);
+
+	float3 bbMin = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+	float3 bbMax = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	std::vector<SpatialKdEvent> events;
+	events.reserve(triangleCount * 6);
+
+	std::vector<uint32> triangles(triangleCount);
+	for (uint32 triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex)
+	{
+		float3* positions = &context._positionArray[triangleIndex * 3];
+		float3 triangleBBMin = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+		float3 triangleBBMax = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			positions[cornerIndex] = meshView.getCornerPosition(triangleIndex, cornerIndex);
+			for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+			{
+				triangleBBMin[axisIndex] = std::min(triangleBBMin[axisIndex], positions[cornerIndex][axisIndex]);
+				triangleBBMax[axisIndex] = std::max(triangleBBMax[axisIndex], positions[cornerIndex][axisIndex]);
+			}
+		}
+
+		for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+		{
+			bbMin[axisIndex] = std::min(bbMin[axisIndex], triangleBBMin[axisIndex]);
+			bbMax[axisIndex] = std::max(bbMax[axisIndex], triangleBBMax[axisIndex]);
+		}
+
+		outSpatialTree._triangleArray[triangleIndex * 3 + 0] = positions[0];
+		outSpatialTree._triangleArray[triangleIndex * 3 + 1] = positions[1] - positions[0];
+		outSpatialTree._triangleArray[triangleIndex * 3 + 2] = positions[2] - positions[0];
+
+		addTriangleEvents(events, triangleIndex, triangleBBMin, triangleBBMax);
+		triangles[triangleIndex] = triangleIndex;
+	}
+
+	outSpatialTree._bbMin = bbMin;
+	outSpatialTree._bbMax = bbMax;
+
+	// Note(jinpark) : 2 step - the only full sort, every node below keeps its events sorted by splitting and merging
+	std::sort(events.begin(), events.end());
+	buildSpatialNode(context, events, triangles, bbMin, bbMax, 0);
+
+	// Note(jinpark) : 3 step - ropes, every face of the scene bound leads outside
+	const uint32 sceneRopes[6] = { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff };
+	buildRopes(outSpatialTree, 0, sceneRopes);
+}
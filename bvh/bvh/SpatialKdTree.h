@@ -0,0 +1,58 @@
+#pragma once
+
+#include "KdTree.h"
+
+const uint32 kSpatialKdAxisMask = 3;
+const uint32 kSpatialKdLeafAxis = 3;
+const uint32 kSpatialKdIndexShift = 2;
+
+// Note(jinpark) : 8 bytes, pre-order. internal (split, rightChildIndex << 2 | axis), the left child is the next node.
+//				   leaf (unused, leafIndex << 2 | kSpatialKdLeafAxis).
+struct SpatialKdNode
+{
+	float _split;
+	uint32 _parameter;
+
+	bool isLeaf() const { return kSpatialKdLeafAxis == (_parameter & kSpatialKdAxisMask); }
+	uint32 getAxis() const { return _parameter & kSpatialKdAxisMask; }
+	uint32 getIndex() const { return _parameter >> kSpatialKdIndexShift; }
+};
+
+// Note(jinpark) : rope of face (axis * 2 + 0) is the neighbour below bbMin, (axis * 2 + 1) above bbMax, 0xffffffff outside the scene.
+//				   ropes point at the smallest node that still covers the whole face, a leaf when the face is not split further.
+struct SpatialKdLeaf
+{
+	float3 _bbMin;
+	uint32 _referenceBegin;
+	float3 _bbMax;
+	uint32 _referenceCount;
+	uint32 _ropeArray[6];
+};
+
+// Note(jinpark) : spatial subdivision, a triangle that straddles a split plane is referenced by both sides.
+//				   _triangleArray has position0, edge0, edge1 per triangle in source order, _referenceArray holds triangle indices.
+struct SpatialKdTree
+{
+	float3 _bbMin;
+	float3 _bbMax;
+	std::vector<SpatialKdNode> _nodeArray;
+	std::vector<SpatialKdLeaf> _leafArray;
+	std::vector<uint32> _referenceArray;
+	std::vector<float3> _triangleArray;
+};
+
+struct SpatialKdTreeSettings
+{
+	float _traversalCost = 1.0f;
+	float _intersectionCost = 1.5f;
+	float _emptyBonus = 0.2f;	// Note(jinpark) : cost scale (1 - bonus) for splits that cut off empty space
+	uint32 _maxDepth = 0;		// Note(jinpark) : 0 is 8 + 1.3 * log2(triangleCount)
+};
+
+class SpatialKdTreeBuilder
+{
+public:
+	// Note(jinpark) : SAH over the sorted split events of every axis, O(n log n). split candidates are the bounds of
+	//				   the triangles clipped to the node, so a straddling triangle only adds the part inside each child.
+	static void build(SpatialKdTree& outSpatialTree, const KdTreeMeshView& meshView, const SpatialKdTreeSettings& settings = SpatialKdTreeSettings());
+};
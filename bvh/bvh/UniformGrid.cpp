@@ -0,0 +1,231 @@
+#include "UniformGrid.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// Note(jinpark) : cells are tested slightly larger than they are, a triangle on a cell face is in both cells.
+const float kGridOverlapEpsilon = 1e-5f;
+
+static void decodeTriangles(std::vector<float3>& outPositionArray, std::vector<float3>& outTriangleArray, float3& outBBMin, float3& outBBMax, const KdTreeMeshView& meshView)
+{
+	const uint32 triangleCount = meshView._indexCount / 3;
+	outPositionArray.resize(triangleCount * 3);
+	outTriangleArray.resize(triangleCount * 3);
+
+	outBBMin = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+	outBBMax = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32 triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex)
+	{
+		float3* positions = &outPositionArray[triangleIndex * 3];
+		for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+		{
+			positions[cornerIndex] = meshView.getCornerPosition(triangleIndex, cornerIndex);
+			for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+			{
+				outBBMin[axisIndex] = std::min(outBBMin[axisIndex], positions[cornerIndex][axisIndex]);
+				outBBMax[axisIndex] = std::max(outBBMax[axisIndex], positions[cornerIndex][axisIndex]);
+			}
+		}
+
+		outTriangleArray[triangleIndex * 3 + 0] = positions[0];
+		outTriangleArray[triangleIndex * 3 + 1] = positions[1] - positions[0];
+		outTriangleArray[triangleIndex * 3 + 2] = positions[2] - positions[0];
+	}
+}
+
+// Note(jinpark) : cells per axis in proportion to the extents, density * triangleCount cells in total.
+//				   flat axes get one cell and are left out of the volume.
+static void setupGridLevel(GridLevel& outLevel, const float3& bbMin, const float3& bbMax, const uint32 triangleCount, const float density, const uint32 maxResolution)
+{
+	outLevel._bbMin = bbMin;
+	outLevel._bbMax = bbMax;
+
+	const float3 extents = bbMax - bbMin;
+	const float maxExtent = std::max(extents.x, std::max(extents.y, extents.z));
+
+	float volume = 1.0f;
+	uint32 dimensionCount = 0;
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		if (maxExtent * kGridOverlapEpsilon < extents[axisIndex])
+		{
+			volume *= extents[axisIndex];
+			++dimensionCount;
+		}
+	}
+
+	const float cellCount = std::max(density * triangleCount, 1.0f);
+	const float cellsPerLength = (0 == dimensionCount) ? 0.0f : powf(cellCount / volume, 1.0f / dimensionCount);
+
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		const bool isFlatAxis = (extents[axisIndex] <= maxExtent * kGridOverlapEpsilon);
+		const float resolution = isFlatAxis ? 1.0f : extents[axisIndex] * cellsPerLength;
+
+		outLevel._resolution[axisIndex] = std::min(std::max(static_cast<uint32>(resolution), 1u), maxResolution);
+		outLevel._cellSize[axisIndex] = extents[axisIndex] / outLevel._resolution[axisIndex];
+		outLevel._inverseCellSize[axisIndex] = (0.0f < extents[axisIndex]) ? outLevel._resolution[axisIndex] / extents[axisIndex] : 0.0f;
+	}
+}
+
+static uint32 getCellCoordinate(const GridLevel& level, const float position, const uint32 axis)
+{
+	const float coordinate = (position - level._bbMin[axis]) * level._inverseCellSize[axis];
+	return std::min(static_cast<uint32>(std::max(coordinate, 0.0f)), level._resolution[axis] - 1);
+}
+
+// Note(jinpark) : cells in the triangle bound that the triangle plane crosses.
+template <typename VisitCell>
+static void forEachOverlappedCell(const GridLevel& level, const float3* positions, VisitCell& visitCell)
+{
+	uint32 cellMin[3], cellMax[3];
+	for (uint32 axisIndex = 0; axisIndex < 3; ++axisIndex)
+	{
+		const float minPosition = std::min(positions[0][axisIndex], std::min(positions[1][axisIndex], positions[2][axisIndex]));
+		const float maxPosition = std::max(positions[0][axisIndex], std::max(positions[1][axisIndex], positions[2][axisIndex]));
+		cellMin[axisIndex] = getCellCoordinate(level, minPosition, axisIndex);
+		cellMax[axisIndex] = getCellCoordinate(level, maxPosition, axisIndex);
+	}
+
+	const bool isSingleCell = (cellMin[0] == cellMax[0]) && (cellMin[1] == cellMax[1]) && (cellMin[2] == cellMax[2]);
+
+	const float3 normal = float3::Cross(positions[1] - positions[0], positions[2] - positions[0]);
+	const float3 absoluteNormal = float3(fabsf(normal.x), fabsf(normal.y), fabsf(normal.z));
+	const float3 halfCellSize = level._cellSize * (0.5f + kGridOverlapEpsilon);
+
+	for (uint32 z = cellMin[2]; z <= cellMax[2]; ++z)
+	{
+		for (uint32 y = cellMin[1]; y <= cellMax[1]; ++y)
+		{
+			for (uint32 x = cellMin[0]; x <= cellMax[0]; ++x)
+			{
+				if (false == isSingleCell)
+				{
+					const float3 cellCenter = level._bbMin + float3((x + 0.5f) * level._cellSize.x, (y + 0.5f) * level._cellSize.y, (z + 0.5f) * level._cellSize.z);
+					const float planeDistance = float3::Dot(normal, cellCenter - positions[0]);
+					if (float3::Dot(absoluteNormal, halfCellSize) < fabsf(planeDistance))
+					{
+						continue;
+					}
+				}
+
+				visitCell((z * level._resolution[1] + y) * level._resolution[0] + x);
+			}
+		}
+	}
+}
+
+// Note(jinpark) : count, prefix sum, fill. the references of a cell keep the order of triangles.
+static void fillGridLevel(GridLevel& outLevel, const std::vector<float3>& positionArray, const uint32* triangles, const uint32 triangleCount)
+{
+	const uint32 cellCount = outLevel.getCellCount();
+	outLevel._cellBeginArray.assign(cellCount + 1, 0);
+
+	auto countCell = [&outLevel](const uint32 cellIndex)
+	{
+		++outLevel._cellBeginArray[cellIndex + 1];
+	};
+	for (uint32 i = 0; i < triangleCount; ++i)
+	{
+		forEachOverlappedCell(outLevel, &positionArray[triangles[i] * 3], countCell);
+	}
+
+	for (uint32 cellIndex = 0; cellIndex < cellCount; ++cellIndex)
+	{
+		outLevel._cellBeginArray[cellIndex + 1] += outLevel._cellBeginArray[cellIndex];
+	}
+
+	outLevel._referenceArray.resize(outLevel._cellBeginArray[cellCount]);
+	std::vector<uint32> cellOffsetArray(outLevel._cellBeginArray.begin(), outLevel._cellBeginArray.end() - 1);
+
+	uint32 triangleIndex = 0;
+	auto fillCell = [&outLevel, &cellOffsetArray, &triangleIndex](const uint32 cellIndex)
+	{
+		outLevel._referenceArray[cellOffsetArray[cellIndex]++] = triangleIndex;
+	};
+	for (uint32 i = 0; i < triangleCount; ++i)
+	{
+		triangleIndex = triangles[i];
+		forEachOverlappedCell(outLevel, &positionArray[triangleIndex * 3], fillCell);
+	}
+}
+
+void GridBuilder::build(UniformGrid& outGrid, const KdTreeMeshView& meshView, const GridSettings& settings)
+{
+	const uint32 triangleCount = meshView._indexCount / 3;
+
+	std::vector<float3> positionArray;
+	float3 bbMin, bbMax;
+	decodeTriangles(positionArray, outGrid._triangleArray, bbMin, bbMax, meshView);
+
+	if (0 == triangleCount)
+	{
+		outGrid._level = GridLevel();
+		return;
+	}
+
+	std::vector<uint32> triangles(triangleCount);
+	for (uint32 i = 0; i < triangleCount; ++i)
+	{
+		triangles[i] = i;
+	}
+
+	setupGridLevel(outGrid._level, bbMin, bbMax, triangleCount, settings._density, settings._maxResolution);
+	fillGridLevel(outGrid._level, positionArray, triangles.data(), triangleCount);
+}
+
+void GridBuilder::build(HierarchicalGrid& outGrid, const KdTreeMeshView& meshView, const GridSettings& settings)
+{
+	const uint32 triangleCount = meshView._indexCount / 3;
+
+	std::vector<float3> positionArray;
+	float3 bbMin, bbMax;
+	decodeTriangles(positionArray, outGrid._triangleArray, bbMin, bbMax, meshView);
+
+	outGrid._subLevelArray.clear();
+	if (0 == triangleCount)
+	{
+		outGrid._topLevel = GridLevel();
+		outGrid._subLevelIndexArray.clear();
+		return;
+	}
+
+	std::vector<uint32> triangles(triangleCount);
+	for (uint32 i = 0; i < triangleCount; ++i)
+	{
+		triangles[i] = i;
+	}
+
+	// Note(jinpark) : 1 step - coarse top level over every triangle
+	GridLevel& topLevel = outGrid._topLevel;
+	setupGridLevel(topLevel, bbMin, bbMax, triangleCount, settings._topDensity, settings._maxResolution);
+	fillGridLevel(topLevel, positionArray, triangles.data(), triangleCount);
+
+	// Note(jinpark) : 2 step - a sub level for every crowded top cell, sized by its own reference count
+	const uint32 topCellCount = topLevel.getCellCount();
+	outGrid._subLevelIndexArray.assign(topCellCount, 0xffffffff);
+
+	for (uint32 cellIndex = 0; cellIndex < topCellCount; ++cellIndex)
+	{
+		const uint32 referenceBegin = topLevel._cellBeginArray[cellIndex];
+		const uint32 referenceCount = topLevel._cellBeginArray[cellIndex + 1] - referenceBegin;
+		if (referenceCount <= settings._subLevelTriangleCount)
+		{
+			continue;
+		}
+
+		const uint32 x = cellIndex % topLevel._resolution[0];
+		const uint32 y = (cellIndex / topLevel._resolution[0]) % topLevel._resolution[1];
+		const uint32 z = cellIndex / (topLevel._resolution[0] * topLevel._resolution[1]);
+
+		const float3 cellBBMin = topLevel._bbMin + float3(x * topLevel._cellSize.x, y * topLevel._cellSize.y, z * topLevel._cellSize.z);
+		const float3 cellBBMax = cellBBMin + topLevel._cellSize;
+
+		outGrid._subLevelIndexArray[cellIndex] = static_cast<uint32>(outGrid._subLevelArray.size());
+		outGrid._subLevelArray.emplace_back();
+
+		GridLevel& subLevel = outGrid._subLevelArray.back();
+		setupGridLevel(subLevel, cellBBMin, cellBBMax, referenceCount, settings._density, settings._maxResolution);
+		fillGridLevel(subLevel, positionArray, &topLevel._referenceArray[referenceBegin], referenceCount);
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "KdTree.h"
+
+// Note(jinpark) : one grid over a box. cell (x, y, z) is (z * resolution.y + y) * resolution.x + x and references
+//				   _referenceArray[_cellBeginArray[cell], _cellBeginArray[cell + 1]).
+struct GridLevel
+{
+	float3 _bbMin;
+	float3 _bbMax;
+	float3 _cellSize;
+	float3 _inverseCellSize;	// Note(jinpark) : 0 on an axis of no extent, everything is then in cell 0
+	uint32 _resolution[3] = { 0, 0, 0 };
+
+	std::vector<uint32> _cellBeginArray;
+	std::vector<uint32> _referenceArray;
+
+	uint32 getCellCount() const { return _resolution[0] * _resolution[1] * _resolution[2]; }
+};
+
+// Note(jinpark) : _triangleArray has position0, edge0, edge1 per triangle in source order, references are triangle indices.
+struct UniformGrid
+{
+	GridLevel _level;
+	std::vector<float3> _triangleArray;
+};
+
+// Note(jinpark) : coarse top grid, a top cell with many triangles gets its own grid over the cell box.
+//				   _subLevelIndexArray is per top cell, 0xffffffff when the cell uses its top level references.
+struct HierarchicalGrid
+{
+	GridLevel _topLevel;
+	std::vector<uint32> _subLevelIndexArray;
+	std::vector<GridLevel> _subLevelArray;
+	std::vector<float3> _triangleArray;
+};
+
+struct GridSettings
+{
+	float _density = 2.0f;					// Note(jinpark) : cells per triangle
+	uint32 _maxResolution = 256;			// Note(jinpark) : per axis
+	float _topDensity = 0.125f;				// Note(jinpark) : top level of HierarchicalGrid
+	uint32 _subLevelTriangleCount = 16;		// Note(jinpark) : a top cell with more references gets a sub level
+};
+
+class GridBuilder
+{
+public:
+	static void build(UniformGrid& outGrid, const KdTreeMeshView& meshView, const GridSettings& settings = GridSettings());
+	static void build(HierarchicalGrid& outGrid, const KdTreeMeshView& meshView, const GridSettings& settings = GridSettings());
+};
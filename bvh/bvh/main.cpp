@@ -1,8 +1,40 @@
 #include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
 
 #include "KdTree.h"
+#include "KdTreeTraversal.h"
+#include "KdTreeLayout.h"
+#include "SpatialKdTree.h"
+#include "UniformGrid.h"
+#include "PointKdTree.h"
 #include "BasicGeometryGenerator.h"
 
+struct BenchmarkRay
+{
+	float3 _origin;
+	float3 _direction;
+};
+
+template <typename Intersect>
+static void benchmarkTraversal(const char* name, const std::vector<BenchmarkRay>& rayArray, size_t byteCount, Intersect intersect)
+{
+	uint32 hitCount = 0;
+
+	const auto beginTime = std::chrono::steady_clock::now();
+	for (const BenchmarkRay& ray : rayArray)
+	{
+		KdTreeHit hit;
+		hitCount += intersect(hit, ray._origin, ray._direction) ? 1 : 0;
+	}
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - beginTime;
+
+	std::cout << name << " : " << elapsed.count() << " ms, " << hitCount << " hits, " << byteCount << " bytes" << std::endl;
+}
+
 int main()
 {
 	PrimitiveBuffer primitiveBuffer = BasicGeometryGenerator::CreateSphere(10.0f, 32, 32);
@@ -13,8 +45,300 @@ int main()
 	kdTree.build(packedNodeArray, primitiveBuffer._vertexBuffer.data(), sizeof(float3), primitiveBuffer._indexBuffer.data(), primitiveBuffer._indexBuffer.size());
 
 	{
+		// Note(jinpark) : leaf encodings on the same tree, rays from a box around the sphere toward its inside.
+		IndexedKdTree indexedTree;
+		kdTree.build(indexedTree, primitiveBuffer._vertexBuffer.data(), sizeof(float3), primitiveBuffer._indexBuffer.data(), primitiveBuffer._indexBuffer.size());
+
+		LeafKdTree woopTree, watertightTree;
+		kdTree.build(woopTree, KdTreeLeafEncoding::Woop, primitiveBuffer._vertexBuffer.data(), sizeof(float3), primitiveBuffer._indexBuffer.data(), primitiveBuffer._indexBuffer.size());
+		kdTree.build(watertightTree, KdTreeLeafEncoding::Watertight, primitiveBuffer._vertexBuffer.data(), sizeof(float3), primitiveBuffer._indexBuffer.data(), primitiveBuffer._indexBuffer.size());
+
+		QuadKdTree quadTree;
+		kdTree.build(quadTree, primitiveBuffer._vertexBuffer.data(), sizeof(float3), primitiveBuffer._indexBuffer.data(), primitiveBuffer._indexBuffer.size());
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+		std::vector<BenchmarkRay> rayArray(1 << 20);
+		for (BenchmarkRay& ray : rayArray)
+		{
+			ray._origin = float3(distribution(random), distribution(random), distribution(random)) * 20.0f;
+			const float3 target = float3(distribution(random), distribution(random), distribution(random)) * 7.0f;
+			ray._direction = (target - ray._origin).Normalized();
+		}
+
+		benchmarkTraversal("edge      ", rayArray, packedNodeArray.size() * sizeof(PackedKdNode), [&packedNodeArray](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, packedNodeArray, origin, direction, FLT_MAX);
+			});
+		benchmarkTraversal("indexed   ", rayArray, indexedTree.getByteCount(), [&indexedTree](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, indexedTree, origin, direction, FLT_MAX);
+			});
+		benchmarkTraversal("woop      ", rayArray, woopTree._nodeArray.size() * sizeof(PackedKdNode), [&woopTree](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, woopTree, origin, direction, FLT_MAX);
+			});
+		benchmarkTraversal("watertight", rayArray, watertightTree._nodeArray.size() * sizeof(PackedKdNode), [&watertightTree](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, watertightTree, origin, direction, FLT_MAX);
+			});
+		benchmarkTraversal("quad      ", rayArray, quadTree._nodeArray.size() * sizeof(PackedKdNode), [&quadTree](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, quadTree, origin, direction, FLT_MAX);
+			});
+
+		// Note(jinpark) : SAH kd-tree with ropes on the same mesh.
+		KdTreeMeshView meshView;
+		meshView._vertices = primitiveBuffer._vertexBuffer.data();
+		meshView._stride = sizeof(float3);
+		meshView._indices = primitiveBuffer._indexBuffer.data();
+		meshView._indexCount = static_cast<uint32>(primitiveBuffer._indexBuffer.size());
+
+		SpatialKdTree spatialTree;
+		SpatialKdTreeBuilder::build(spatialTree, meshView);
+
+		const size_t spatialByteCount = spatialTree._nodeArray.size() * sizeof(SpatialKdNode) + spatialTree._leafArray.size() * sizeof(SpatialKdLeaf)
+									  + spatialTree._referenceArray.size() * sizeof(uint32) + spatialTree._triangleArray.size() * sizeof(float3);
+		benchmarkTraversal("spatial kd", rayArray, spatialByteCount, [&spatialTree](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, spatialTree, origin, direction, FLT_MAX);
+			});
+
+		// Note(jinpark) : grids on the same mesh, build time matters as much as trace time for them.
+		const auto gridBeginTime = std::chrono::steady_clock::now();
+		UniformGrid uniformGrid;
+		GridBuilder::build(uniformGrid, meshView);
+		const auto hierarchicalGridBeginTime = std::chrono::steady_clock::now();
+		HierarchicalGrid hierarchicalGrid;
+		GridBuilder::build(hierarchicalGrid, meshView);
+		const auto gridEndTime = std::chrono::steady_clock::now();
+
+		const std::chrono::duration<double, std::milli> uniformGridElapsed = hierarchicalGridBeginTime - gridBeginTime;
+		const std::chrono::duration<double, std::milli> hierarchicalGridElapsed = gridEndTime - hierarchicalGridBeginTime;
+		std::cout << "grid build : uniform " << uniformGridElapsed.count() << " ms, hierarchical " << hierarchicalGridElapsed.count() << " ms" << std::endl;
+
+		const size_t uniformGridByteCount = (uniformGrid._level._cellBeginArray.size() + uniformGrid._level._referenceArray.size()) * sizeof(uint32) + uniformGrid._triangleArray.size() * sizeof(float3);
+		benchmarkTraversal("grid      ", rayArray, uniformGridByteCount, [&uniformGrid](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, uniformGrid, origin, direction, FLT_MAX);
+			});
+
+		size_t hierarchicalGridByteCount = (hierarchicalGrid._topLevel._cellBeginArray.size() + hierarchicalGrid._topLevel._referenceArray.size() + hierarchicalGrid._subLevelIndexArray.size()) * sizeof(uint32)
+										 + hierarchicalGrid._triangleArray.size() * sizeof(float3);
+		for (const GridLevel& subLevel : hierarchicalGrid._subLevelArray)
+		{
+			hierarchicalGridByteCount += sizeof(GridLevel) + (subLevel._cellBeginArray.size() + subLevel._referenceArray.size()) * sizeof(uint32);
+		}
+		benchmarkTraversal("grid 2    ", rayArray, hierarchicalGridByteCount, [&hierarchicalGrid](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, hierarchicalGrid, origin, direction, FLT_MAX);
+			});
+
+		// Note(jinpark) : analytic spheres on the sphere vertices, same rays.
+		std::vector<KdSphere> sphereArray(primitiveBuffer._vertexBuffer.size());
+		for (size_t sphereIndex = 0; sphereIndex < sphereArray.size(); ++sphereIndex)
+		{
+			sphereArray[sphereIndex]._center = primitiveBuffer._vertexBuffer[sphereIndex];
+			sphereArray[sphereIndex]._radius = 0.5f;
+		}
+
+		ShapeKdTree sphereTree;
+		kdTree.build(sphereTree, sphereArray.data(), static_cast<uint32>(sphereArray.size()));
+
+		benchmarkTraversal("spheres   ", rayArray, sphereTree._nodeArray.size() * sizeof(PackedKdNode) + sphereTree._shapeArray.size() * sizeof(KdShape), [&sphereTree](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, sphereTree, origin, direction, FLT_MAX);
+			});
+	}
+
+	{
+		// Note(jinpark) : node orders on a tree well beyond L1, cache misses come from KdTreeCacheModel (32KB L1, 1MB L2).
+		PrimitiveBuffer largeBuffer = BasicGeometryGenerator::CreateSphere(10.0f, 256, 256);
+
+		std::vector<PackedKdNode> largeNodeArray;
+		kdTree.build(largeNodeArray, largeBuffer._vertexBuffer.data(), sizeof(float3), largeBuffer._indexBuffer.data(), largeBuffer._indexBuffer.size());
+
+		std::mt19937 random(2);
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+		std::vector<BenchmarkRay> rayArray(1 << 18);
+		for (BenchmarkRay& ray : rayArray)
+		{
+			ray._origin = float3(distribution(random), distribution(random), distribution(random)) * 20.0f;
+			const float3 target = float3(distribution(random), distribution(random), distribution(random)) * 7.0f;
+			ray._direction = (target - ray._origin).Normalized();
+		}
+
+		const char* layoutNames[] = { "depth first  ", "breadth first", "van Emde Boas", "treelet 64B  ", "treelet 4KB  " };
+		KdTreeLayoutSettings layoutSettings[5];
+		layoutSettings[1]._order = KdTreeNodeOrder::BreadthFirst;
+		layoutSettings[2]._order = KdTreeNodeOrder::VanEmdeBoas;
+		layoutSettings[3]._order = KdTreeNodeOrder::Treelet;
+		layoutSettings[3]._treeletByteCount = 64;
+		layoutSettings[4]._order = KdTreeNodeOrder::Treelet;
+		layoutSettings[4]._treeletByteCount = 4096;
+
+		for (uint32 layoutIndex = 0; layoutIndex < 5; ++layoutIndex)
+		{
+			OrderedKdTree orderedTree;
+			KdTreeLayout::build(orderedTree, largeNodeArray.data(), static_cast<uint32>(largeNodeArray.size()), layoutSettings[layoutIndex]);
+
+			benchmarkTraversal(layoutNames[layoutIndex], rayArray, orderedTree._nodeArray.size() * sizeof(PackedKdNode), [&orderedTree](KdTreeHit& hit, const float3& origin, const float3& direction)
+				{
+					return KdTreeTraversal::intersect(hit, orderedTree, origin, direction, FLT_MAX);
+				});
+
+			KdTreeCacheModel l1CacheModel;
+			KdTreeCacheModel l2CacheModel(1 << 20, 16, 64);
+			KdTreeCacheModel tlbModel(64 * 4096, 4, 4096);	// Note(jinpark) : 64 entries of 4KB pages
+			for (const BenchmarkRay& ray : rayArray)
+			{
+				KdTreeHit hit;
+				KdTreeTraversal::intersect(hit, orderedTree, ray._origin, ray._direction, FLT_MAX, l1CacheModel);
+				KdTreeTraversal::intersect(hit, orderedTree, ray._origin, ray._direction, FLT_MAX, l2CacheModel);
+				KdTreeTraversal::intersect(hit, orderedTree, ray._origin, ray._direction, FLT_MAX, tlbModel);
+			}
+
+			const double rayCount = static_cast<double>(rayArray.size());
+			std::cout << "    L1 misses / ray : " << l1CacheModel.getMissCount() / rayCount << ", L2 misses / ray : " << l2CacheModel.getMissCount() / rayCount
+				<< ", TLB misses / ray : " << tlbModel.getMissCount() / rayCount << std::endl;
+		}
+	}
+
+	{
+		// Note(jinpark) : motion blur, the sphere moves and grows between the keyframes. the baseline is the usual
+		//				   tree over the union bound of each triangle with the triangle lerped in the intersector.
+		std::vector<float3> vertexArray1(primitiveBuffer._vertexBuffer.size());
+		for (size_t vertexIndex = 0; vertexIndex < vertexArray1.size(); ++vertexIndex)
+		{
+			vertexArray1[vertexIndex] = primitiveBuffer._vertexBuffer[vertexIndex] * 1.2f + float3(4.0f, 0.0f, 0.0f);
+		}
+
+		KdTreeMeshView meshView;
+		meshView._vertices = primitiveBuffer._vertexBuffer.data();
+		meshView._stride = sizeof(float3);
+		meshView._indices = primitiveBuffer._indexBuffer.data();
+		meshView._indexCount = static_cast<uint32>(primitiveBuffer._indexBuffer.size());
+
+		MotionKdTree motionTree;
+		kdTree.build(motionTree, meshView, vertexArray1.data());
+
+		auto getCornerPositions = [&primitiveBuffer, &vertexArray1](float3* outPositions, const uint32 primitiveIndex, const float time)
+		{
+			for (uint32 cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+			{
+				const uint32 vertexIndex = primitiveBuffer._indexBuffer[primitiveIndex * 3 + cornerIndex];
+				outPositions[cornerIndex] = primitiveBuffer._vertexBuffer[vertexIndex] * (1.0f - time) + vertexArray1[vertexIndex] * time;
+			}
+		};
+
+		ShapeKdTree unionTree;
+		kdTree.build(unionTree, static_cast<uint32>(primitiveBuffer._indexBuffer.size() / 3), [&getCornerPositions](float3& outBBMin, float3& outBBMax, const uint32 primitiveIndex)
+			{
+				float3 positions[6];
+				getCornerPositions(positions + 0, primitiveIndex, 0.0f);
+				getCornerPositions(positions + 3, primitiveIndex, 1.0f);
+
+				outBBMin = outBBMax = positions[0];
+				for (const float3& position : positions)
+				{
+					outBBMin = float3(std::min(outBBMin.x, position.x), std::min(outBBMin.y, position.y), std::min(outBBMin.z, position.z));
+					outBBMax = float3(std::max(outBBMax.x, position.x), std::max(outBBMax.y, position.y), std::max(outBBMax.z, position.z));
+				}
+			});
+
+		std::mt19937 random(4);
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+		std::vector<BenchmarkRay> rayArray(1 << 18);
+		std::vector<float> timeArray(rayArray.size());
+		for (size_t rayIndex = 0; rayIndex < rayArray.size(); ++rayIndex)
+		{
+			BenchmarkRay& ray = rayArray[rayIndex];
+			ray._origin = float3(distribution(random), distribution(random), distribution(random)) * 20.0f;
+			const float3 target = float3(distribution(random), distribution(random), distribution(random)) * 7.0f;
+			ray._direction = (target - ray._origin).Normalized();
+			timeArray[rayIndex] = distribution(random) * 0.5f + 0.5f;
+		}
+
+		uint32 rayIndex = 0;
+		benchmarkTraversal("motion    ", rayArray, motionTree._nodeArray.size() * sizeof(PackedKdNode) + motionTree._positionArray.size() * sizeof(float3), [&motionTree, &timeArray, &rayIndex](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				return KdTreeTraversal::intersect(hit, motionTree, origin, direction, FLT_MAX, timeArray[rayIndex++]);
+			});
+
+		rayIndex = 0;
+		benchmarkTraversal("union box ", rayArray, unionTree._nodeArray.size() * sizeof(PackedKdNode) + unionTree._shapeArray.size() * sizeof(KdShape), [&unionTree, &timeArray, &rayIndex, &getCornerPositions](KdTreeHit& hit, const float3& origin, const float3& direction)
+			{
+				const float time = timeArray[rayIndex++];
+				return KdTreeTraversal::intersect(hit, unionTree, origin, direction, FLT_MAX, [time, &getCornerPositions](float& inOutT, const KdShape& shape, const float3& origin, const float3& direction, const float)
+					{
+						float3 positions[3];
+						getCornerPositions(positions, shape._primitiveIndex, time);
+
+						float u, v;
+						return KdTreeTraversal::intersectTriangle(inOutT, u, v, origin, direction, positions[0], positions[1] - positions[0], positions[2] - positions[0]);
+					});
+			});
+	}
+
+	{
+		// Note(jinpark) : point k-d tree, 16 nearest and fixed radius around random points in a 1M point cloud.
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+		std::vector<float3> pointArray(1 << 20);
+		for (float3& point : pointArray)
+		{
+			point = float3(distribution(random), distribution(random), distribution(random)) * 10.0f;
+		}
+
+		const auto buildBeginTime = std::chrono::steady_clock::now();
+		PointKdTree pointTree;
+		PointKdTreeSearch::build(pointTree, pointArray.data(), sizeof(float3), static_cast<uint32>(pointArray.size()));
+		const std::chrono::duration<double, std::milli> buildElapsed = std::chrono::steady_clock::now() - buildBeginTime;
+
+		std::vector<PointKdNeighbor> neighborArray;
+		uint64 nearestCount = 0, radiusCount = 0;
+
+		const auto searchBeginTime = std::chrono::steady_clock::now();
+		for (uint32 queryIndex = 0; queryIndex < (1 << 16); ++queryIndex)
+		{
+			const float3 position = float3(distribution(random), distribution(random), distribution(random)) * 10.0f;
+			nearestCount += PointKdTreeSearch::findNearest(neighborArray, pointTree, position, 16, FLT_MAX);
+			radiusCount += PointKdTreeSearch::findInRadius(neighborArray, pointTree, position, 0.2f);
+		}
+		const std::chrono::duration<double, std::milli> searchElapsed = std::chrono::steady_clock::now() - searchBeginTime;
+
+		std::cout << "point build : " << buildElapsed.count() << " ms, 64K k-NN + radius : " << searchElapsed.count() << " ms, " << nearestCount << " / " << radiusCount << " neighbors" << std::endl;
+
+		// Note(jinpark) : approximate 16 nearest, mean ratio of the k-th distance to the exact one.
+		PointKdSearchSettings searchSettings;
+		searchSettings._epsilon = 0.5f;
+		searchSettings._maxLeafCount = 16;
+
+		std::vector<PointKdNeighbor> exactNeighborArray;
+		double distanceRatioSum = 0.0;
+
+		const auto approximateBeginTime = std::chrono::steady_clock::now();
+		for (uint32 queryIndex = 0; queryIndex < (1 << 16); ++queryIndex)
+		{
+			const float3 position = float3(distribution(random), distribution(random), distribution(random)) * 10.0f;
+			PointKdTreeSearch::findNearest(neighborArray, pointTree, position, 16, FLT_MAX, searchSettings);
+		}
+		const std::chrono::duration<double, std::milli> approximateElapsed = std::chrono::steady_clock::now() - approximateBeginTime;
+
+		for (uint32 queryIndex = 0; queryIndex < (1 << 10); ++queryIndex)
+		{
+			const float3 position = float3(distribution(random), distribution(random), distribution(random)) * 10.0f;
+			PointKdTreeSearch::findNearest(neighborArray, pointTree, position, 16, FLT_MAX, searchSettings);
+			PointKdTreeSearch::findNearest(exactNeighborArray, pointTree, position, 16, FLT_MAX);
+			distanceRatioSum += sqrt(neighborArray.back()._distance2 / exactNeighborArray.back()._distance2);
+		}
 
+		std::cout << "point 64K approximate k-NN : " << approximateElapsed.count() << " ms, k-th distance ratio " << distanceRatioSum / (1 << 10) << std::endl;
 	}
 
 	return 0;
-}
\ No newline at end of file
+}